@@ -24,6 +24,8 @@
 
 #include <bdtree/error_code.h>
 
+#include <crossbow/logger.hpp>
+
 #include <stdexcept>
 #include <utility>
 
@@ -49,25 +51,8 @@ store::GenericTuple createNodeTuple(const char* data, size_t length) {
 
 } // anonymous namespace
 
-BdTreeNodeData::BdTreeNodeData(store::Table& table, store::Record::id_t id, std::unique_ptr<store::Tuple> tuple)
-        : mTuple(std::move(tuple)),
-          mSize(0x0u),
-          mData(nullptr) {
-    bool isNull = false;
-    store::FieldType type;
-    auto field = table.record().data(mTuple->data(), id, isNull, &type);
-    if (isNull || type != store::FieldType::BLOB) {
-        throw std::logic_error("Invalid field");
-    }
-
-    auto offsetData = reinterpret_cast<const uint32_t*>(field);
-    auto offset = offsetData[0];
-    mSize = offsetData[1] - offset;
-    mData = mTuple->data() + offset;
-}
-
 std::unique_ptr<store::Tuple> BdTreeBaseTable::doRead(uint64_t key, std::error_code& ec) {
-    auto getFuture = mHandle.get(mTable.table(), key);
+    auto getFuture = mHandle->get(mTable.table(), key);
     if (getFuture->waitForResult()) {
         return getFuture->get();
     } else if (getFuture->error() == store::error::not_found) {
@@ -80,7 +65,7 @@ std::unique_ptr<store::Tuple> BdTreeBaseTable::doRead(uint64_t key, std::error_c
 }
 
 bool BdTreeBaseTable::doInsert(uint64_t key, store::GenericTuple tuple, std::error_code& ec) {
-    auto insertFuture = mHandle.insert(mTable.table(), key, 0x0u, std::move(tuple));
+    auto insertFuture = mHandle->insert(mTable.table(), key, 0x0u, std::move(tuple));
     if (insertFuture->waitForResult()) {
         return true;
     }
@@ -93,7 +78,7 @@ bool BdTreeBaseTable::doInsert(uint64_t key, store::GenericTuple tuple, std::err
 }
 
 bool BdTreeBaseTable::doUpdate(uint64_t key, store::GenericTuple tuple, uint64_t version, std::error_code& ec) {
-    auto updateFuture = mHandle.update(mTable.table(), key, version, std::move(tuple));
+    auto updateFuture = mHandle->update(mTable.table(), key, version, std::move(tuple));
     if (updateFuture->waitForResult()) {
         return true;
     }
@@ -108,7 +93,7 @@ bool BdTreeBaseTable::doUpdate(uint64_t key, store::GenericTuple tuple, uint64_t
 }
 
 bool BdTreeBaseTable::doRemove(uint64_t key, uint64_t version, std::error_code& ec) {
-    auto removeFuture = mHandle.remove(mTable.table(), key, version);
+    auto removeFuture = mHandle->remove(mTable.table(), key, version);
     if (removeFuture->waitForResult()) {
         return true;
     }
@@ -122,6 +107,21 @@ bool BdTreeBaseTable::doRemove(uint64_t key, uint64_t version, std::error_code&
     return false;
 }
 
+void BdTreeBaseTable::doRemoveAsync(uint64_t key, uint64_t version) {
+    mPending.emplace_back(mHandle->remove(mTable.table(), key, version));
+}
+
+void BdTreeBaseTable::waitForPending() {
+    for (auto& resp : mPending) {
+        // A failed removal only leaves an unreachable page behind
+        if (!resp->waitForResult()) {
+            LOG_ERROR("Could not remove bdtree node from table %1% [error = %2%]", mTable.table().tableName(),
+                    resp->error().message());
+        }
+    }
+    mPending.clear();
+}
+
 store::Table BdTreePointerTable::createTable(store::ClientHandle& handle, const crossbow::string& name) {
     store::Schema schema(store::TableType::NON_TRANSACTIONAL);
     schema.addField(store::FieldType::BIGINT, gPointerFieldName, true);
@@ -164,27 +164,47 @@ store::Table BdTreeNodeTable::createTable(store::ClientHandle& handle, const cro
     return handle.createTable(name, std::move(schema));
 }
 
-BdTreeNodeTable::BdTreeNodeTable(store::ClientHandle& handle, TableData& table)
-        : BdTreeBaseTable(handle, table) {
+BdTreeNodeTable::BdTreeNodeTable(store::ClientHandle& handle, TableData& table, BdTreeNodeCache* cache)
+        : BdTreeBaseTable(handle, table),
+          mCache(cache),
+          mAsync(false) {
     if (!mTable.table().record().idOf(gNodeFieldName, mNodeDataId)) {
         throw std::logic_error("Node field not found");
     }
 }
 
 BdTreeNodeData BdTreeNodeTable::read(bdtree::physical_pointer pptr, std::error_code& ec) {
+    BdTreeNodeData node;
+    if (mCache && mCache->get(mTable.table().tableId(), pptr.value, node)) {
+        return node;
+    }
+
     auto tuple = doRead(pptr.value, ec);
     if (!tuple)
         return BdTreeNodeData();
 
-    return BdTreeNodeData(mTable.table(), mNodeDataId, std::move(tuple));
+    node = BdTreeNodeData(mTable.table(), mNodeDataId, std::move(tuple));
+    if (mCache) {
+        mCache->insert(mTable.table().tableId(), pptr.value, node);
+    }
+    return node;
 }
 
 void BdTreeNodeTable::insert(bdtree::physical_pointer pptr, const char* data, size_t length, std::error_code& ec) {
-    doInsert(pptr.value, createNodeTuple(data, length), ec);
+    if (doInsert(pptr.value, createNodeTuple(data, length), ec) && mCache) {
+        mCache->insert(mTable.table().tableId(), pptr.value, BdTreeNodeData(data, length));
+    }
 }
 
 void BdTreeNodeTable::remove(bdtree::physical_pointer pptr, std::error_code& ec) {
-    doRemove(pptr.value, 0x1u, ec);
+    if (mCache) {
+        mCache->remove(mTable.table().tableId(), pptr.value);
+    }
+    if (mAsync) {
+        doRemoveAsync(pptr.value, 0x1u);
+    } else {
+        doRemove(pptr.value, 0x1u, ec);
+    }
 }
 
 } // namespace db
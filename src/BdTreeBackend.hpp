@@ -22,6 +22,7 @@
  */
 #pragma once
 
+#include "BdTreeNodeCache.hpp"
 #include "TableData.hpp"
 
 #include <tellstore/ClientManager.hpp>
@@ -35,33 +36,11 @@
 
 #include <cstdint>
 #include <memory>
+#include <vector>
 
 namespace tell {
 namespace db {
 
-class BdTreeNodeData {
-public:
-    BdTreeNodeData()
-            : mSize(0x0u),
-              mData(nullptr) {
-    }
-
-    BdTreeNodeData(store::Table& table, store::Record::id_t id, std::unique_ptr<store::Tuple> tuple);
-
-    const char* data() const {
-        return mData;
-    }
-
-    size_t length() const {
-        return mSize;
-    }
-
-private:
-    std::unique_ptr<store::Tuple> mTuple;
-    uint32_t mSize;
-    const char* mData;
-};
-
 /**
  * @brief Base class for shared functionality between BdTreePointerTable and BdTreeNodeTable
  */
@@ -69,17 +48,24 @@ class BdTreeBaseTable {
 protected:
     BdTreeBaseTable(store::ClientHandle& handle, TableData& table)
             : mTable(table),
-              mHandle(handle) {
+              mHandle(&handle) {
     }
 
     ~BdTreeBaseTable() = default;
 
+    /**
+     * @brief Rebinds the table to the client handle of another transaction
+     */
+    void setHandle(store::ClientHandle& handle) {
+        mHandle = &handle;
+    }
+
     uint64_t nextKey() {
-        return mTable.nextKey(mHandle);
+        return mTable.nextKey(*mHandle);
     }
 
     uint64_t remoteKey() {
-        return mTable.remoteKey(mHandle);
+        return mTable.remoteKey(*mHandle);
     }
 
     std::unique_ptr<store::Tuple> doRead(uint64_t key, std::error_code& ec);
@@ -90,10 +76,25 @@ protected:
 
     bool doRemove(uint64_t key, uint64_t version, std::error_code& ec);
 
+    /**
+     * @brief Issues a remove without waiting for the response
+     *
+     * The response is awaited by the next call to waitForPending().
+     */
+    void doRemoveAsync(uint64_t key, uint64_t version);
+
+    /**
+     * @brief Waits for all outstanding asynchronous requests
+     *
+     * Failed removals are logged, each one leaves an unreachable page behind.
+     */
+    void waitForPending();
+
     TableData& mTable;
 
 private:
-    store::ClientHandle& mHandle;
+    store::ClientHandle* mHandle;
+    std::vector<std::shared_ptr<store::ModificationResponse>> mPending;
 };
 
 /**
@@ -107,6 +108,8 @@ public:
             : BdTreeBaseTable(handle, table) {
     }
 
+    using BdTreeBaseTable::setHandle;
+
     bdtree::logical_pointer get_next_ptr() {
         return bdtree::logical_pointer{nextKey()};
     }
@@ -134,12 +137,16 @@ public:
 
 /**
  * @brief Node table for the Bd-Tree storing the physical Bd-Tree pages
+ *
+ * Reads are served from the shared node cache (if one is set) before going to the storage.
  */
 class BdTreeNodeTable : public bdtree::base_node_table<BdTreeNodeTable, BdTreeNodeData>, private BdTreeBaseTable  {
 public:
     static store::Table createTable(store::ClientHandle& handle, const crossbow::string& name);
 
-    BdTreeNodeTable(store::ClientHandle& handle, TableData& table);
+    BdTreeNodeTable(store::ClientHandle& handle, TableData& table, BdTreeNodeCache* cache);
+
+    using BdTreeBaseTable::setHandle;
 
     bdtree::physical_pointer get_next_ptr() {
         return bdtree::physical_pointer{nextKey()};
@@ -161,8 +168,18 @@ public:
 
     using bdtree::base_node_table<BdTreeNodeTable, BdTreeNodeData>::remove;
 
+    void setAsync(bool async) {
+        mAsync = async;
+    }
+
+    void flush() {
+        waitForPending();
+    }
+
 private:
     store::Record::id_t mNodeDataId;
+    BdTreeNodeCache* mCache;
+    bool mAsync;
 };
 
 /**
@@ -174,9 +191,10 @@ public:
 
     using node_table = BdTreeNodeTable;
 
-    BdTreeBackend(store::ClientHandle& handle, TableData& ptrTable, TableData& nodeTable)
+    BdTreeBackend(store::ClientHandle& handle, TableData& ptrTable, TableData& nodeTable,
+            BdTreeNodeCache* nodeCache = nullptr)
             : mPtr(handle, ptrTable),
-              mNode(handle, nodeTable) {
+              mNode(handle, nodeTable, nodeCache) {
     }
 
     ptr_table& get_ptr_table() {
@@ -187,6 +205,32 @@ public:
         return mNode;
     }
 
+    /**
+     * @brief Enables or disables the asynchronous mode
+     *
+     * In asynchronous mode requests the Bd-Tree does not depend on - the removal of pages that were replaced by a
+     * new version - are issued without waiting for their response. The outstanding requests are awaited together in
+     * flush().
+     */
+    void setAsync(bool async) {
+        mNode.setAsync(async);
+    }
+
+    /**
+     * @brief Waits for all requests issued in asynchronous mode
+     */
+    void flush() {
+        mNode.flush();
+    }
+
+    /**
+     * @brief Binds the backend to the client handle of the transaction using it
+     */
+    void setHandle(store::ClientHandle& handle) {
+        mPtr.setHandle(handle);
+        mNode.setHandle(handle);
+    }
+
 private:
     ptr_table mPtr;
     node_table mNode;
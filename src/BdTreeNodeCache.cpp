@@ -0,0 +1,146 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#include "BdTreeNodeCache.hpp"
+
+#include <tellstore/Table.hpp>
+
+#include <cstring>
+#include <stdexcept>
+
+namespace tell {
+namespace db {
+
+constexpr size_t BdTreeNodeCache::DEFAULT_CAPACITY;
+constexpr size_t BdTreeNodeCache::NUM_SHARDS;
+
+BdTreeNodeData::BdTreeNodeData(store::Table& table, store::Record::id_t id, std::unique_ptr<store::Tuple> tuple)
+        : mSize(0x0u),
+          mData(nullptr) {
+    bool isNull = false;
+    store::FieldType type;
+    auto tupleData = tuple->data();
+    auto field = table.record().data(tupleData, id, isNull, &type);
+    if (isNull || type != store::FieldType::BLOB) {
+        throw std::logic_error("Invalid field");
+    }
+
+    auto offsetData = reinterpret_cast<const uint32_t*>(field);
+    auto offset = offsetData[0];
+    mSize = offsetData[1] - offset;
+    mData = tupleData + offset;
+    mOwner = std::move(tuple);
+}
+
+BdTreeNodeData::BdTreeNodeData(const char* data, size_t length)
+        : mSize(static_cast<uint32_t>(length)),
+          mData(nullptr) {
+    std::shared_ptr<char> buffer(new char[length], std::default_delete<char[]>());
+    memcpy(buffer.get(), data, length);
+    mData = buffer.get();
+    mOwner = std::move(buffer);
+}
+
+BdTreeNodeCache::BdTreeNodeCache(size_t capacity)
+        : mShardCapacity(capacity / NUM_SHARDS),
+          mHits(0x0u),
+          mMisses(0x0u),
+          mEvictions(0x0u) {
+}
+
+bool BdTreeNodeCache::get(uint64_t tableId, uint64_t pptr, BdTreeNodeData& data) {
+    Key key(tableId, pptr);
+    auto& shard = shardOf(key);
+    {
+        ShardLock _(shard);
+        auto i = shard.entries.find(key);
+        if (i != shard.entries.end()) {
+            i->second.referenced = true;
+            data = i->second.data;
+            mHits.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    mMisses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void BdTreeNodeCache::insert(uint64_t tableId, uint64_t pptr, const BdTreeNodeData& data) {
+    if (data.length() > mShardCapacity.load(std::memory_order_relaxed)) {
+        return;
+    }
+    Key key(tableId, pptr);
+    auto& shard = shardOf(key);
+    ShardLock _(shard);
+    auto res = shard.entries.emplace(key, Entry{data, false});
+    if (!res.second) {
+        return;
+    }
+    shard.queue.push_back(key);
+    shard.size += data.length();
+    evict(shard);
+}
+
+void BdTreeNodeCache::remove(uint64_t tableId, uint64_t pptr) {
+    Key key(tableId, pptr);
+    auto& shard = shardOf(key);
+    ShardLock _(shard);
+    auto i = shard.entries.find(key);
+    if (i == shard.entries.end()) {
+        return;
+    }
+    // The key stays in the eviction queue and is skipped once it reaches the front
+    shard.size -= i->second.data.length();
+    shard.entries.erase(i);
+    if (shard.queue.size() > 2 * shard.entries.size() + 64) {
+        std::deque<Key> queue;
+        for (const auto& k : shard.queue) {
+            if (shard.entries.count(k) != 0) {
+                queue.push_back(k);
+            }
+        }
+        shard.queue.swap(queue);
+    }
+}
+
+void BdTreeNodeCache::evict(Shard& shard) {
+    auto capacity = mShardCapacity.load(std::memory_order_relaxed);
+    while (shard.size > capacity && !shard.queue.empty()) {
+        auto key = shard.queue.front();
+        shard.queue.pop_front();
+        auto i = shard.entries.find(key);
+        if (i == shard.entries.end()) {
+            continue;
+        }
+        if (i->second.referenced) {
+            i->second.referenced = false;
+            shard.queue.push_back(key);
+            continue;
+        }
+        shard.size -= i->second.data.length();
+        shard.entries.erase(i);
+        mEvictions.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+} // namespace db
+} // namespace tell
@@ -0,0 +1,171 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+
+#include <tellstore/ClientManager.hpp>
+
+#include <crossbow/non_copyable.hpp>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <unordered_map>
+
+namespace tell {
+namespace db {
+
+/**
+ * @brief Data of a physical Bd-Tree page
+ *
+ * The page data is shared between all copies of the object: either the TellStore tuple it was read from or a copy of
+ * the page that was written.
+ */
+class BdTreeNodeData {
+public:
+    BdTreeNodeData()
+            : mSize(0x0u),
+              mData(nullptr) {
+    }
+
+    BdTreeNodeData(store::Table& table, store::Record::id_t id, std::unique_ptr<store::Tuple> tuple);
+
+    BdTreeNodeData(const char* data, size_t length);
+
+    const char* data() const {
+        return mData;
+    }
+
+    size_t length() const {
+        return mSize;
+    }
+
+private:
+    std::shared_ptr<const void> mOwner;
+    uint32_t mSize;
+    const char* mData;
+};
+
+/**
+ * @brief Process wide cache of physical Bd-Tree pages
+ *
+ * Physical pages are never updated in place: a page is inserted under a fresh physical pointer and later removed. A
+ * cached page therefore never gets stale and the cache can be shared by all threads without any invalidation protocol.
+ *
+ * The cache is split into shards each protected by a spinlock. Every shard holds a share of the total capacity and
+ * evicts pages in FIFO order, giving pages that were read since their last eviction check a second chance.
+ */
+class BdTreeNodeCache : crossbow::non_copyable, crossbow::non_movable {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 64 * 1024 * 1024;
+
+    BdTreeNodeCache(size_t capacity = DEFAULT_CAPACITY);
+
+    /**
+     * @brief Looks up the page with the given physical pointer in the node table
+     *
+     * @return True if the page was cached, the page is then stored in data
+     */
+    bool get(uint64_t tableId, uint64_t pptr, BdTreeNodeData& data);
+
+    void insert(uint64_t tableId, uint64_t pptr, const BdTreeNodeData& data);
+
+    void remove(uint64_t tableId, uint64_t pptr);
+
+    /**
+     * @brief Changes the total size of the cached pages
+     *
+     * A shard exceeding its new share evicts pages the next time a page is inserted into it.
+     */
+    void setCapacity(size_t capacity) {
+        mShardCapacity.store(capacity / NUM_SHARDS, std::memory_order_relaxed);
+    }
+
+    uint64_t hits() const {
+        return mHits.load(std::memory_order_relaxed);
+    }
+
+    uint64_t misses() const {
+        return mMisses.load(std::memory_order_relaxed);
+    }
+
+    uint64_t evictions() const {
+        return mEvictions.load(std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr size_t NUM_SHARDS = 64;
+
+    using Key = std::pair<uint64_t, uint64_t>;
+
+    struct KeyHash {
+        size_t operator() (const Key& key) const {
+            return std::hash<uint64_t>()(key.first * 0x9e3779b97f4a7c15ull ^ key.second);
+        }
+    };
+
+    struct Entry {
+        BdTreeNodeData data;
+        bool referenced;
+    };
+
+    struct Shard {
+        std::atomic_flag lock = ATOMIC_FLAG_INIT;
+        std::unordered_map<Key, Entry, KeyHash> entries;
+        std::deque<Key> queue;
+        size_t size = 0;
+    };
+
+    class ShardLock {
+    public:
+        ShardLock(Shard& shard)
+                : mShard(shard) {
+            while (mShard.lock.test_and_set(std::memory_order_acquire)) {
+            }
+        }
+
+        ~ShardLock() {
+            mShard.lock.clear(std::memory_order_release);
+        }
+
+    private:
+        Shard& mShard;
+    };
+
+    Shard& shardOf(const Key& key) {
+        return mShards[KeyHash()(key) % NUM_SHARDS];
+    }
+
+    void evict(Shard& shard);
+
+    std::atomic<size_t> mShardCapacity;
+    std::array<Shard, NUM_SHARDS> mShards;
+
+    std::atomic<uint64_t> mHits;
+    std::atomic<uint64_t> mMisses;
+    std::atomic<uint64_t> mEvictions;
+};
+
+} // namespace db
+} // namespace tell
@@ -0,0 +1,89 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include <telldb/Types.hpp>
+
+#include <crossbow/non_copyable.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <unordered_map>
+
+namespace tell {
+namespace db {
+namespace impl {
+
+/**
+ * @brief Sizes of the transaction caches recently needed on one thread
+ *
+ * Every transaction allocates its caches from its own memory pool. Growing a hash table within the pool leaves the
+ * old bucket array behind as garbage, so the caches are created with the capacity recent transactions of the thread
+ * needed. For every size the history keeps a maximum that decays by an eighth per transaction, so a single large
+ * transaction does not keep the caches of all following ones large.
+ */
+class CacheSizeHistory : crossbow::non_copyable, crossbow::non_movable {
+public:
+    struct Sizes {
+        /// Number of tuples read
+        size_t reads = 0;
+        /// Number of modified tuples
+        size_t changes = 0;
+    };
+
+    /**
+     * @brief Number of tables recent transactions accessed
+     */
+    size_t tables() const {
+        return mTables;
+    }
+
+    /**
+     * @brief Sizes of the table caches recent transactions needed for the given table
+     */
+    Sizes table(table_t table) const {
+        auto i = mSizes.find(table);
+        return i == mSizes.end() ? Sizes() : i->second;
+    }
+
+    void recordTables(size_t tables) {
+        mTables = decay(mTables, tables);
+    }
+
+    void recordTable(table_t table, size_t reads, size_t changes) {
+        auto& sizes = mSizes[table];
+        sizes.reads = decay(sizes.reads, reads);
+        sizes.changes = decay(sizes.changes, changes);
+    }
+
+private:
+    static size_t decay(size_t previous, size_t current) {
+        return std::max(current, previous - (previous + 7) / 8);
+    }
+
+    size_t mTables = 0;
+    std::unordered_map<table_t, Sizes> mSizes;
+};
+
+} // namespace impl
+} // namespace db
+} // namespace tell
@@ -0,0 +1,334 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include <telldb/Types.hpp>
+
+#include <crossbow/ChunkAllocator.hpp>
+#include <crossbow/non_copyable.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+
+namespace tell {
+namespace db {
+
+/**
+ * @brief Open addressing hash map from tuple or table keys to values, allocated from a memory pool
+ *
+ * Entries are stored in one flat array and collisions are resolved by linear probing, so a lookup usually touches a
+ * single cache line. Erased entries leave a tombstone behind until the next rehash: Erasing never moves other entries,
+ * so iterators stay valid when erasing during an iteration. Inserting a new key may rehash and invalidates all
+ * iterators and references, emplacing an existing key never does. The table doubles once more than half of it is in
+ * use, memory of the arrays replaced on growth is returned with the pool.
+ *
+ * The key type has to be a key_t like struct with an integral value member.
+ */
+template<class K, class V>
+class FlatMap : crossbow::non_copyable, crossbow::non_movable {
+public: // types
+    using key_type = K;
+    using mapped_type = V;
+    using value_type = std::pair<K, V>;
+
+    template<class Value>
+    class basic_iterator : public std::iterator<std::forward_iterator_tag, Value> {
+        friend class FlatMap;
+        Value* mEntries;
+        const uint8_t* mStates;
+        size_t mIdx;
+        size_t mCapacity;
+
+        basic_iterator(Value* entries, const uint8_t* states, size_t idx, size_t capacity)
+            : mEntries(entries)
+            , mStates(states)
+            , mIdx(idx)
+            , mCapacity(capacity)
+        {
+            skip();
+        }
+
+        void skip() {
+            while (mIdx < mCapacity && mStates[mIdx] != FULL) {
+                ++mIdx;
+            }
+        }
+    public:
+        template<class Other>
+        basic_iterator(const basic_iterator<Other>& other)
+            : mEntries(other.mEntries)
+            , mStates(other.mStates)
+            , mIdx(other.mIdx)
+            , mCapacity(other.mCapacity)
+        {}
+
+        Value& operator*() const {
+            return mEntries[mIdx];
+        }
+
+        Value* operator->() const {
+            return &mEntries[mIdx];
+        }
+
+        basic_iterator& operator++() {
+            ++mIdx;
+            skip();
+            return *this;
+        }
+
+        basic_iterator operator++(int) {
+            auto res = *this;
+            ++(*this);
+            return res;
+        }
+
+        bool operator==(const basic_iterator& other) const {
+            return mIdx == other.mIdx;
+        }
+
+        bool operator!=(const basic_iterator& other) const {
+            return mIdx != other.mIdx;
+        }
+
+        template<class> friend class basic_iterator;
+    };
+
+    using iterator = basic_iterator<value_type>;
+    using const_iterator = basic_iterator<const value_type>;
+
+private: // constants
+    static constexpr uint8_t EMPTY = 0;
+    static constexpr uint8_t FULL = 1;
+    static constexpr uint8_t ERASED = 2;
+    static constexpr size_t INITIAL_CAPACITY = 16;
+
+private: // members
+    crossbow::ChunkMemoryPool& mPool;
+    value_type* mEntries = nullptr;
+    uint8_t* mStates = nullptr;
+    size_t mCapacity = 0;
+    size_t mSize = 0;
+    /// Number of entries plus tombstones
+    size_t mUsed = 0;
+
+public: // construction
+    FlatMap(crossbow::ChunkMemoryPool* pool, size_t expected = 0)
+        : mPool(*pool)
+    {
+        if (expected != 0) {
+            reserve(expected);
+        }
+    }
+
+    ~FlatMap() {
+        for (size_t i = 0; i < mCapacity; ++i) {
+            if (mStates[i] == FULL) {
+                mEntries[i].~value_type();
+            }
+        }
+    }
+
+public: // access
+    size_t size() const {
+        return mSize;
+    }
+
+    bool empty() const {
+        return mSize == 0;
+    }
+
+    iterator begin() {
+        return iterator(mEntries, mStates, 0, mCapacity);
+    }
+
+    iterator end() {
+        return iterator(mEntries, mStates, mCapacity, mCapacity);
+    }
+
+    const_iterator begin() const {
+        return const_iterator(mEntries, mStates, 0, mCapacity);
+    }
+
+    const_iterator end() const {
+        return const_iterator(mEntries, mStates, mCapacity, mCapacity);
+    }
+
+    iterator find(K key) {
+        auto idx = lookup(key);
+        return idx == mCapacity ? end() : iterator(mEntries, mStates, idx, mCapacity);
+    }
+
+    const_iterator find(K key) const {
+        auto idx = lookup(key);
+        return idx == mCapacity ? end() : const_iterator(mEntries, mStates, idx, mCapacity);
+    }
+
+    size_t count(K key) const {
+        return lookup(key) == mCapacity ? 0 : 1;
+    }
+
+    V& at(K key) {
+        auto idx = lookup(key);
+        if (idx == mCapacity) {
+            throw std::out_of_range("Key not in map");
+        }
+        return mEntries[idx].second;
+    }
+
+    const V& at(K key) const {
+        auto idx = lookup(key);
+        if (idx == mCapacity) {
+            throw std::out_of_range("Key not in map");
+        }
+        return mEntries[idx].second;
+    }
+
+public: // modifiers
+    /**
+     * @brief Inserts the value if the key is not yet in the map
+     *
+     * @return The iterator to the entry of the key and whether the value was inserted
+     */
+    template<class... Args>
+    std::pair<iterator, bool> emplace(K key, Args&&... args) {
+        // Look for the key first so that hitting an existing entry never rehashes and invalidates iterators
+        auto idx = lookup(key);
+        if (idx != mCapacity) {
+            return std::make_pair(iterator(mEntries, mStates, idx, mCapacity), false);
+        }
+        if ((mUsed + 1) * 2 > mCapacity) {
+            // Rehashing drops the tombstones, the table only grows if the entries need the space
+            rehash(std::max(mCapacity, capacityFor(mSize + 1)));
+        }
+        // The key is not in the map, so the first free slot (empty or tombstone) of the probe sequence is taken
+        idx = slot(key);
+        while (mStates[idx] == FULL) {
+            idx = (idx + 1) & (mCapacity - 1);
+        }
+        if (mStates[idx] == EMPTY) {
+            ++mUsed;
+        }
+        new (&mEntries[idx]) value_type(std::piecewise_construct, std::forward_as_tuple(key),
+                std::forward_as_tuple(std::forward<Args>(args)...));
+        mStates[idx] = FULL;
+        ++mSize;
+        return std::make_pair(iterator(mEntries, mStates, idx, mCapacity), true);
+    }
+
+    std::pair<iterator, bool> insert(value_type value) {
+        return emplace(value.first, std::move(value.second));
+    }
+
+    V& operator[](K key) {
+        return emplace(key).first->second;
+    }
+
+    /**
+     * @brief Removes the entry the iterator points to
+     *
+     * @return The iterator to the next entry
+     */
+    iterator erase(iterator pos) {
+        auto idx = pos.mIdx;
+        mEntries[idx].~value_type();
+        mStates[idx] = ERASED;
+        --mSize;
+        return iterator(mEntries, mStates, idx + 1, mCapacity);
+    }
+
+    size_t erase(K key) {
+        auto idx = lookup(key);
+        if (idx == mCapacity) {
+            return 0;
+        }
+        erase(iterator(mEntries, mStates, idx, mCapacity));
+        return 1;
+    }
+
+    /**
+     * @brief Grows the table so that it can hold the given number of entries without growing again
+     */
+    void reserve(size_t expected) {
+        auto capacity = capacityFor(expected);
+        if (capacity > mCapacity) {
+            rehash(capacity);
+        }
+    }
+
+private:
+    static size_t capacityFor(size_t expected) {
+        size_t capacity = INITIAL_CAPACITY;
+        while (capacity < expected * 2) {
+            capacity *= 2;
+        }
+        return capacity;
+    }
+
+    size_t slot(K key) const {
+        // Fibonacci hashing spreads consecutive keys over the table
+        return static_cast<size_t>((static_cast<uint64_t>(key.value) * 0x9E3779B97F4A7C15ull) >> 32) & (mCapacity - 1);
+    }
+
+    size_t lookup(K key) const {
+        if (mSize == 0) {
+            return mCapacity;
+        }
+        for (auto idx = slot(key); mStates[idx] != EMPTY; idx = (idx + 1) & (mCapacity - 1)) {
+            if (mStates[idx] == FULL && mEntries[idx].first == key) {
+                return idx;
+            }
+        }
+        return mCapacity;
+    }
+
+    void rehash(size_t capacity) {
+        auto oldEntries = mEntries;
+        auto oldStates = mStates;
+        auto oldCapacity = mCapacity;
+        mEntries = reinterpret_cast<value_type*>(mPool.allocate(capacity * sizeof(value_type)));
+        mStates = reinterpret_cast<uint8_t*>(mPool.allocate(capacity));
+        memset(mStates, EMPTY, capacity);
+        mCapacity = capacity;
+        mUsed = mSize;
+        for (size_t i = 0; i < oldCapacity; ++i) {
+            if (oldStates[i] != FULL) {
+                continue;
+            }
+            auto idx = slot(oldEntries[i].first);
+            while (mStates[idx] == FULL) {
+                idx = (idx + 1) & (mCapacity - 1);
+            }
+            new (&mEntries[idx]) value_type(std::move(oldEntries[i]));
+            mStates[idx] = FULL;
+            oldEntries[i].~value_type();
+        }
+    }
+};
+
+} // namespace db
+} // namespace tell
@@ -0,0 +1,55 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#include <telldb/Transaction.hpp>
+
+#include <algorithm>
+
+namespace tell {
+namespace db {
+
+constexpr size_t Transaction::DEFAULT_INDEX_PREFETCH;
+
+IndexScan::IndexScan(Transaction& transaction, table_t table, Iterator iter, size_t prefetch)
+    : mTransaction(transaction)
+    , mTable(table)
+    , mIter(std::move(iter))
+    , mPrefetch(std::max(prefetch, size_t(1)))
+{
+    fill();
+}
+
+void IndexScan::next() {
+    mPending.pop_front();
+    fill();
+}
+
+void IndexScan::fill() {
+    while (mPending.size() < mPrefetch && !mIter.done()) {
+        auto key = mIter.value();
+        mPending.emplace_back(key, mTransaction.get(mTable, key));
+        mIter.next();
+    }
+}
+
+} // namespace db
+} // namespace tell
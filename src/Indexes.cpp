@@ -21,19 +21,39 @@
  *     Lucas Braun <braunl@inf.ethz.ch>
  */
 #include "Indexes.hpp"
-#include "FieldSerialize.hpp"
 #include <telldb/Exceptions.hpp>
 #include <exception>
 
 using namespace tell::db;
 using namespace tell::db::impl;
 
+namespace {
+
+/**
+ * @brief Runs the backend in asynchronous mode for the lifetime of the object
+ */
+class AsyncBackendScope {
+    BdTreeBackend& mBackend;
+public:
+    AsyncBackendScope(BdTreeBackend& backend)
+        : mBackend(backend)
+    {
+        mBackend.setAsync(true);
+    }
+    ~AsyncBackendScope() {
+        mBackend.flush();
+        mBackend.setAsync(false);
+    }
+};
+
+} // anonymous namespace
+
 namespace bdtree {
 
 template<>
 struct null_key<tell::db::impl::UniqueKeyType> {
     static tell::db::impl::UniqueKeyType value() {
-        return std::make_tuple(std::vector<Field>{},
+        return std::make_tuple(tell::db::impl::EncodedKey{},
                 std::numeric_limits<uint64_t>::max());
     }
 };
@@ -41,7 +61,7 @@ struct null_key<tell::db::impl::UniqueKeyType> {
 template<>
 struct null_key<tell::db::impl::NonUniqueKeyType> {
     static tell::db::impl::NonUniqueKeyType value() {
-        return std::make_tuple(std::vector<Field>{},
+        return std::make_tuple(tell::db::impl::EncodedKey{},
                 std::numeric_limits<uint64_t>::max(),
                 tell::db::key_t{0});
     }
@@ -86,6 +106,27 @@ void Iterator::next() {
     mImpl->next();
 }
 
+void Iterator::seek(const KeyType& key) {
+    mImpl->seek(encodeKey(key));
+}
+
+void Iterator::seek(const IndexKey& key) {
+    mImpl->seek(key.data());
+}
+
+std::vector<std::pair<size_t, ValueType>> Iterator::multiSeek(const std::vector<KeyType>& keys) {
+    std::vector<std::pair<size_t, ValueType>> res;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        auto key = encodeKey(keys[i]);
+        mImpl->seek(key);
+        while (!mImpl->done() && mImpl->encodedKey().compare(0, key.size(), key) == 0) {
+            res.emplace_back(i, mImpl->value());
+            mImpl->next();
+        }
+    }
+    return res;
+}
+
 const KeyType& Iterator::key() const {
     return mImpl->key();
 }
@@ -101,23 +142,38 @@ IteratorDirection Iterator::direction() const {
 namespace impl {
 
 IteratorImpl::~IteratorImpl() {}
+
+const KeyType& IteratorImpl::key() const {
+    if (!mKeyDecoded) {
+        mKey = decodeKey(encodedKey());
+        mKeyDecoded = true;
+    }
+    return mKey;
+}
+
 BdTree::~BdTree() {}
 
-UniqueBdTree::UniqueBdTree(const commitmanager::SnapshotDescriptor& snapshot, BdTreeBackend& backend, bool doInit)
+UniqueBdTree::UniqueBdTree(const commitmanager::SnapshotDescriptor& snapshot,
+        BdTreeBackend& backend,
+        UniqueIndexCache& cache,
+        bool doInit)
         : BdTree(snapshot)
-        , mMap(backend, mCache, mSnapshot.version(), doInit)
+        , mMap(backend, cache, mSnapshot.version(), doInit)
     {}
 
-NonUniqueBdTree::NonUniqueBdTree(const commitmanager::SnapshotDescriptor& snapshot, BdTreeBackend& backend, bool doInit)
+NonUniqueBdTree::NonUniqueBdTree(const commitmanager::SnapshotDescriptor& snapshot,
+        BdTreeBackend& backend,
+        NonUniqueIndexCache& cache,
+        bool doInit)
         : BdTree(snapshot)
-        , mMap(backend, mCache, mSnapshot.version(), doInit)
+        , mMap(backend, cache, mSnapshot.version(), doInit)
     {}
 
-bool UniqueBdTree::insert(const KeyType& key, const ValueType& value) {
+bool UniqueBdTree::insert(const EncodedKey& key, const ValueType& value) {
     return mMap.insert(std::make_tuple(key, std::numeric_limits<uint64_t>::max()), value);
 }
 
-bool UniqueBdTree::erase(const KeyType& key, const ValueType& value) {
+bool UniqueBdTree::erase(const EncodedKey& key, const ValueType& value) {
     if (!mMap.insert(std::make_tuple(key, mSnapshot.version()), value)) {
         return false;
     }
@@ -128,34 +184,30 @@ bool UniqueBdTree::erase(const KeyType& key, const ValueType& value) {
     return true;
 }
 
-void UniqueBdTree::revertInsert(const KeyType& key, ValueType) {
+void UniqueBdTree::revertInsert(const EncodedKey& key, ValueType) {
     mMap.erase(std::make_tuple(key, std::numeric_limits<uint64_t>::max()));
 }
 
-void UniqueBdTree::revertErase(const KeyType& key, ValueType value) {
+void UniqueBdTree::revertErase(const EncodedKey& key, ValueType value) {
     mMap.insert(std::make_tuple(key, std::numeric_limits<uint64_t>::max()), value);
     mMap.erase(std::make_tuple(key, mSnapshot.version()));
 }
 
-auto UniqueBdTree::lower_bound(const KeyType& key) -> Iterator {
-    return Iterator(std::unique_ptr<IteratorImpl>(ForwardIterator<Map>::create(mSnapshot,
-                    mMap.find(std::make_tuple(key, 0)), mMap)));
+std::unique_ptr<IteratorImpl> UniqueBdTree::lower_bound(const EncodedKey& key, const KeyBound& bound) {
+    return std::unique_ptr<IteratorImpl>(ForwardIterator<Map>::create(mSnapshot,
+                findFirst(mMap, key), mMap, bound));
 }
 
-auto UniqueBdTree::reverse_lower_bound(const KeyType& key) -> Iterator {
-    auto end = mMap.end();
-    auto iter = mMap.find_last_smaller_equal(std::make_tuple(key, std::numeric_limits<uint64_t>::max()));
-    while (iter != end && std::get<0>(iter->first) > key) {
-        --iter;
-    }
-    return std::unique_ptr<IteratorImpl>(BackwardIterator<Map>::create(mSnapshot, iter, mMap));
+std::unique_ptr<IteratorImpl> UniqueBdTree::reverse_lower_bound(const EncodedKey& key, const KeyBound& bound) {
+    return std::unique_ptr<IteratorImpl>(BackwardIterator<Map>::create(mSnapshot,
+                findLast(mMap, key), mMap, bound));
 }
 
-bool NonUniqueBdTree::insert(const KeyType& key, const ValueType& value) {
+bool NonUniqueBdTree::insert(const EncodedKey& key, const ValueType& value) {
     return mMap.insert(std::make_tuple(key, std::numeric_limits<uint64_t>::max(), value));
 }
 
-bool NonUniqueBdTree::erase(const KeyType& key, const ValueType& value) {
+bool NonUniqueBdTree::erase(const EncodedKey& key, const ValueType& value) {
     if (!mMap.insert(std::make_tuple(key, mSnapshot.version(), value))) {
         return false;
     }
@@ -166,44 +218,82 @@ bool NonUniqueBdTree::erase(const KeyType& key, const ValueType& value) {
     return true;
 }
 
-void NonUniqueBdTree::revertInsert(const KeyType& key, ValueType value) {
+void NonUniqueBdTree::revertInsert(const EncodedKey& key, ValueType value) {
     mMap.erase(std::make_tuple(key, std::numeric_limits<uint64_t>::max(), value));
 }
 
-void NonUniqueBdTree::revertErase(const KeyType& key, ValueType value) {
+void NonUniqueBdTree::revertErase(const EncodedKey& key, ValueType value) {
     mMap.insert(std::make_tuple(key, std::numeric_limits<uint64_t>::max(), value));
     mMap.erase(std::make_tuple(key, mSnapshot.version(), value));
 }
 
-auto NonUniqueBdTree::lower_bound(const KeyType& key) -> Iterator {
-    return std::unique_ptr<IteratorImpl>(ForwardIterator<Map>::create(mSnapshot, mMap.find(std::make_tuple(key, 0, key_t{0})), mMap));
+std::unique_ptr<IteratorImpl> NonUniqueBdTree::lower_bound(const EncodedKey& key, const KeyBound& bound) {
+    return std::unique_ptr<IteratorImpl>(ForwardIterator<Map>::create(mSnapshot,
+                findFirst(mMap, key), mMap, bound));
 }
 
-auto NonUniqueBdTree::reverse_lower_bound(const KeyType& key) -> Iterator {
-    auto end = mMap.end();
-    auto iter = mMap.find_last_smaller_equal(std::make_tuple(key, std::numeric_limits<uint64_t>::max(), key_t{std::numeric_limits<uint64_t>::max()}));
-    while (iter != end && std::get<0>(*iter) > key) {
-        --iter;
-    }
-    return std::unique_ptr<IteratorImpl>(BackwardIterator<Map>::create(mSnapshot, iter, mMap));
+std::unique_ptr<IteratorImpl> NonUniqueBdTree::reverse_lower_bound(const EncodedKey& key, const KeyBound& bound) {
+    return std::unique_ptr<IteratorImpl>(BackwardIterator<Map>::create(mSnapshot,
+                findLast(mMap, key), mMap, bound));
 }
 
 using namespace commitmanager;
 
+void BackendReleaser::operator() (BdTreeBackend* backend) const {
+    tables->releaseBackend(backend);
+}
+
+IndexTables::IndexTables(const IndexDescriptor& fields,
+        const store::Record& record,
+        TableData ptrTable,
+        TableData nodeTable,
+        BdTreeNodeCache* nodeCache)
+    : fields(fields)
+    , ptrTable(std::move(ptrTable))
+    , nodeTable(std::move(nodeTable))
+    , mNodeCache(nodeCache)
+{
+    fieldTypes.reserve(fields.second.size());
+    for (auto id : fields.second) {
+        fieldTypes.emplace_back(record.getFieldMeta(id).field.type());
+    }
+    if (fields.first) {
+        uniqueCache.reset(new UniqueIndexCache());
+    } else {
+        nonUniqueCache.reset(new NonUniqueIndexCache());
+    }
+}
+
+IndexTables::~IndexTables() = default;
+
+BackendHandle IndexTables::acquireBackend(store::ClientHandle& handle) {
+    if (mBackends.empty()) {
+        return BackendHandle(new BdTreeBackend(handle, ptrTable, nodeTable, mNodeCache), BackendReleaser{this});
+    }
+    auto backend = mBackends.back().release();
+    mBackends.pop_back();
+    backend->setHandle(handle);
+    return BackendHandle(backend, BackendReleaser{this});
+}
+
+void IndexTables::releaseBackend(BdTreeBackend* backend) {
+    mBackends.emplace_back(backend);
+}
+
 IndexWrapper::IndexWrapper(
         const crossbow::string& name,
-        bool uniqueIndex,
-        const std::vector<store::Schema::id_t>& fields,
-        BdTreeBackend&& backend,
+        IndexTables& tables,
+        store::ClientHandle& handle,
         const SnapshotDescriptor& snapshot,
         bool init)
     : mName(name)
-    , mFields(fields)
-    , mBackend(new BdTreeBackend(std::move(backend)))
+    , mFields(tables.fields.second)
+    , mFieldTypes(&tables.fieldTypes)
+    , mBackend(tables.acquireBackend(handle))
     , mSnapshot(snapshot)
-    , mBdTree(uniqueIndex ?
-            static_cast<BdTree*>(new UniqueBdTree(mSnapshot, *mBackend, init)) :
-            static_cast<BdTree*>(new NonUniqueBdTree(mSnapshot, *mBackend, init)))
+    , mBdTree(tables.fields.first ?
+            static_cast<BdTree*>(new UniqueBdTree(mSnapshot, *mBackend, *tables.uniqueCache, init)) :
+            static_cast<BdTree*>(new NonUniqueBdTree(mSnapshot, *mBackend, *tables.nonUniqueCache, init)))
 {
 }
 
@@ -229,15 +319,60 @@ void IndexWrapper::remove(key_t key, const Tuple& tuple) {
 }
 
 auto IndexWrapper::lower_bound(const KeyType& key) -> tell::db::Iterator {
+    return doLowerBound(encodeKey(key), KeyBound(), std::numeric_limits<size_t>::max());
+}
+
+auto IndexWrapper::reverse_lower_bound(const KeyType& key) -> tell::db::Iterator {
+    return doReverseLowerBound(encodeKey(key), KeyBound(), std::numeric_limits<size_t>::max());
+}
+
+auto IndexWrapper::lower_bound(const IndexKey& key) -> tell::db::Iterator {
+    checkTypes(key);
+    return doLowerBound(key.data(), KeyBound(), std::numeric_limits<size_t>::max());
+}
+
+auto IndexWrapper::reverse_lower_bound(const IndexKey& key) -> tell::db::Iterator {
+    checkTypes(key);
+    return doReverseLowerBound(key.data(), KeyBound(), std::numeric_limits<size_t>::max());
+}
+
+void IndexWrapper::checkTypes(const IndexKey& key) const {
+    if (key.size() > mFieldTypes->size()) {
+        throw WrongFieldType(mName);
+    }
+    for (size_t i = 0; i < key.size(); ++i) {
+        auto type = key.type(i);
+        auto fieldType = (*mFieldTypes)[i];
+        // Blobs are encoded like text, an IndexKey has no append for them and takes their bytes as text
+        if (type == store::FieldType::TEXT && fieldType == store::FieldType::BLOB) {
+            continue;
+        }
+        if (type != store::FieldType::NULLTYPE && type != fieldType) {
+            throw WrongFieldType(mName);
+        }
+    }
+}
+
+auto IndexWrapper::range(const KeyRange& range) -> tell::db::Iterator {
+    if (range.bound.direction == IteratorDirection::Forward) {
+        return doLowerBound(range.from, range.bound, range.limit);
+    }
+    return doReverseLowerBound(range.from, range.bound, range.limit);
+}
+
+auto IndexWrapper::doLowerBound(const EncodedKey& key, const KeyBound& bound, size_t limit) -> tell::db::Iterator {
     std::unique_ptr<CacheIteratorImpl> cIter(new BdTree::StdIter<Cache::iterator>(
                 IteratorDirection::Forward,
+                mCache,
                 mCache.lower_bound(key),
-                mCache.end()));
+                mCache.end(),
+                bound));
     return std::unique_ptr<IteratorImpl>(new Iterator(IteratorDirection::Forward,
-                mBdTree->lower_bound(key), std::move(cIter)));
+                mBdTree->lower_bound(key, bound), std::move(cIter), limit));
 }
 
-auto IndexWrapper::reverse_lower_bound(const KeyType& key) -> tell::db::Iterator {
+auto IndexWrapper::doReverseLowerBound(const EncodedKey& key, const KeyBound& bound, size_t limit)
+        -> tell::db::Iterator {
     auto iter = mCache.lower_bound(key);
     auto rIter = std::reverse_iterator<Cache::iterator>(iter);
     if (iter == mCache.end()) {
@@ -246,14 +381,17 @@ auto IndexWrapper::reverse_lower_bound(const KeyType& key) -> tell::db::Iterator
     std::unique_ptr<CacheIteratorImpl> cIter(
             new BdTree::StdIter<decltype(rIter)>(
                 IteratorDirection::Backward,
+                mCache,
                 rIter,
-                mCache.rend()));
+                mCache.rend(),
+                bound));
     return std::unique_ptr<IteratorImpl>(new Iterator(IteratorDirection::Backward,
-                mBdTree->reverse_lower_bound(key), std::move(cIter)));
+                mBdTree->reverse_lower_bound(key, bound), std::move(cIter), limit));
 }
 
 void IndexWrapper::writeBack() {
     crossbow::allocator _;
+    AsyncBackendScope async(*mBackend);
     for (auto& op : mCache) {
         bool res;
         if (std::get<2>(op.second)) continue;
@@ -274,6 +412,7 @@ void IndexWrapper::writeBack() {
 
 void IndexWrapper::undo() {
     crossbow::allocator _;
+    AsyncBackendScope async(*mBackend);
     for (auto& op : mCache) {
         if (!std::get<2>(op.second)) continue;
         switch (std::get<0>(op.second)) {
@@ -287,18 +426,17 @@ void IndexWrapper::undo() {
     }
 }
 
-std::vector<Field> IndexWrapper::keyOf(const Tuple& tuple) {
-    std::vector<Field> key;
-    key.reserve(mFields.size());
+EncodedKey IndexWrapper::keyOf(const Tuple& tuple) {
+    EncodedKey key;
     for (auto f : mFields) {
-        key.emplace_back(tuple[f]);
+        encodeField(tuple[f], key);
     }
     return key;
 }
 
-Indexes::IndexTables::~IndexTables() = default;
-
-Indexes::Indexes(store::ClientHandle& handle) {
+Indexes::Indexes(store::ClientHandle& handle, BdTreeNodeCache* nodeCache)
+    : mNodeCache(nodeCache)
+{
     auto tableRes = handle.getTable("__counter");
     if (tableRes->error()) {
         mCounterTable = RemoteCounter::createTable(handle, "__counter");
@@ -307,25 +445,10 @@ Indexes::Indexes(store::ClientHandle& handle) {
     }
 }
 
-std::unordered_map<crossbow::string, IndexWrapper>
-Indexes::openIndexes(const SnapshotDescriptor& snapshot, store::ClientHandle& handle, const store::Table& table) {
-    std::unordered_map<crossbow::string, IndexWrapper> res;
+const IndexTablesMap& Indexes::indexTables(store::ClientHandle& handle, const store::Table& table) {
     auto iter = mIndexes.find(table_t{table.tableId()});
     if (iter != mIndexes.end()) {
-        for (auto& idx : iter->second) {
-            res.emplace(idx.first,
-                    IndexWrapper(
-                        idx.first,
-                        idx.second->fields.first, // TODO: Unique
-                        idx.second->fields.second,
-                        BdTreeBackend(
-                            handle,
-                            idx.second->ptrTable,
-                            idx.second->nodeTable),
-                        snapshot,
-                        false));
-        }
-        return res;
+        return iter->second;
     }
     const auto& indexes = table.record().schema().indexes();
     std::vector<std::tuple<crossbow::string,
@@ -340,7 +463,7 @@ Indexes::openIndexes(const SnapshotDescriptor& snapshot, store::ClientHandle& ha
                     handle.getTable(nodeTableName),
                     handle.getTable(ptrTableName)));
     }
-    std::unordered_map<crossbow::string, IndexTables*> indexMap;
+    IndexTablesMap indexMap;
     for (auto it = responses.rbegin(); it != responses.rend(); ++it) {
         {
             const auto& ec = std::get<2>(*it)->error();
@@ -356,51 +479,33 @@ Indexes::openIndexes(const SnapshotDescriptor& snapshot, store::ClientHandle& ha
                 throw OpenTableException(crossbow::string(str.c_str(), str.size()));
             }
         }
-        auto insRes = indexMap.emplace(std::get<0>(*it),
-                new IndexTables{
+        indexMap.emplace(std::get<0>(*it),
+                new IndexTables(
                     *std::get<1>(*it),
+                    table.record(),
                     TableData(std::get<3>(*it)->get(), mCounterTable),
-                    TableData(std::get<2>(*it)->get(), mCounterTable)
-                });
-        res.emplace(std::get<0>(*it),
-                IndexWrapper(
-                    std::get<0>(*it),
-                    std::get<1>(*it)->first, // TODO: Unique
-                    std::get<1>(*it)->second,
-                    BdTreeBackend(
-                        handle,
-                        insRes.first->second->ptrTable,
-                        insRes.first->second->nodeTable),
-                    snapshot,
-                    false));
+                    TableData(std::get<2>(*it)->get(), mCounterTable),
+                    mNodeCache
+                ));
     }
-    mIndexes.emplace(table_t{table.tableId()}, std::move(indexMap));
-    return res;
+    return mIndexes.emplace(table_t{table.tableId()}, std::move(indexMap)).first->second;
 }
 
 std::unordered_map<crossbow::string, IndexWrapper>
 Indexes::createIndexes(const SnapshotDescriptor& snapshot, store::ClientHandle& handle, const store::Table& table) {
     std::unordered_map<crossbow::string, IndexWrapper> res;
     const auto& indexes = table.record().schema().indexes();
-    std::unordered_map<crossbow::string, IndexTables*> indexMap;
+    IndexTablesMap indexMap;
     for (const auto& idx : indexes) {
         crossbow::string nodeTableName = "__index_nodes_" + idx.first;
         crossbow::string ptrTableName = "__index_ptrs_" + idx.first;
         auto insRes = indexMap.emplace(idx.first,
-                new IndexTables{idx.second,
+                new IndexTables(idx.second,
+                                table.record(),
                                 TableData(BdTreePointerTable::createTable(handle, ptrTableName), mCounterTable),
-                                TableData(BdTreeNodeTable::createTable(handle, nodeTableName), mCounterTable)});
-        res.emplace(idx.first,
-                IndexWrapper(
-                    idx.first,
-                    idx.second.first, // TODO: Unique
-                    idx.second.second,
-                    BdTreeBackend(
-                        handle,
-                        insRes.first->second->ptrTable,
-                        insRes.first->second->nodeTable),
-                    snapshot,
-                    true));
+                                TableData(BdTreeNodeTable::createTable(handle, nodeTableName), mCounterTable),
+                                mNodeCache));
+        res.emplace(idx.first, IndexWrapper(idx.first, *insRes.first->second, handle, snapshot, true));
     }
     mIndexes.emplace(table_t{table.tableId()}, indexMap);
     return res;
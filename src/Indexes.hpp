@@ -23,6 +23,7 @@
 #pragma once
 #include "TableData.hpp"
 #include "BdTreeBackend.hpp"
+#include "KeyEncoding.hpp"
 #include <telldb/Field.hpp>
 #include <telldb/Types.hpp>
 #include <telldb/TellDB.hpp>
@@ -42,12 +43,12 @@ namespace impl {
 
 /**
  * The key type used in Indexes:
- *  - A list of fields (to support multivalue indexes)
+ *  - The encoded list of fields (to support multivalue indexes)
  *  - A version number. This is set to uint64_max by default,
  *    on deletion it is set to the version of the transaction
  *    that made the deletion
  */
-using UniqueKeyType = std::tuple<KeyType, uint64_t>;
+using UniqueKeyType = std::tuple<EncodedKey, uint64_t>;
 using NonUniqueKeyType = decltype(std::tuple_cat(std::declval<UniqueKeyType>(), std::declval<std::tuple<key_t>>()));
 /**
  * The value for an index map is simply the key of of the tuple
@@ -63,7 +64,57 @@ enum class IndexOperation : uint8_t {
     Insert, Delete
 };
 
-using Cache = std::multimap<KeyType, std::tuple<IndexOperation, ValueType, bool>>;
+using Cache = std::multimap<EncodedKey, std::tuple<IndexOperation, ValueType, bool>>;
+
+/**
+ * @brief End of an index range
+ *
+ * For forward iteration the bound is an upper bound, for backward iteration a lower bound. The bound may be a prefix
+ * of the index key: An inclusive bound includes all keys starting with it, an exclusive bound excludes them.
+ */
+struct KeyBound {
+    EncodedKey key;
+    IteratorDirection direction = IteratorDirection::Forward;
+    bool inclusive = false;
+    bool active = false;
+
+    bool contains(const EncodedKey& k) const {
+        if (!active) {
+            return true;
+        }
+        auto cmp = k.compare(0, key.size(), key);
+        if (direction == IteratorDirection::Forward) {
+            return inclusive ? cmp <= 0 : cmp < 0;
+        }
+        return inclusive ? cmp >= 0 : cmp > 0;
+    }
+};
+
+/**
+ * @brief A bounded index range with a row limit
+ */
+struct KeyRange {
+    EncodedKey from;
+    KeyBound bound;
+    size_t limit = std::numeric_limits<size_t>::max();
+
+    KeyRange(IteratorDirection direction, const KeyType& from, size_t limit)
+        : from(encodeKey(from))
+        , limit(limit)
+    {
+        bound.direction = direction;
+    }
+
+    KeyRange(IteratorDirection direction, const KeyType& from, const KeyType& to, bool inclusive, size_t limit)
+        : from(encodeKey(from))
+        , limit(limit)
+    {
+        bound.key = encodeKey(to);
+        bound.direction = direction;
+        bound.inclusive = inclusive;
+        bound.active = true;
+    }
+};
 
 } // namespace impl
 } // namespace db
@@ -87,6 +138,8 @@ namespace impl {
 
 using UniqueMap = bdtree::map<UniqueKeyType, UniqueValueType, BdTreeBackend>;
 using NonUniqueMap = bdtree::map<NonUniqueKeyType, NonUniqueValueType, BdTreeBackend>;
+using UniqueIndexCache = bdtree::logical_table_cache<UniqueKeyType, UniqueValueType, BdTreeBackend>;
+using NonUniqueIndexCache = bdtree::logical_table_cache<NonUniqueKeyType, NonUniqueValueType, BdTreeBackend>;
 
 template<class Map>
 struct KeyOf;
@@ -99,13 +152,27 @@ template<>
 struct KeyOf<UniqueMap> {
     using type = UniqueKeyType;
 
-    const KeyType& operator() (const std::pair<UniqueKeyType, UniqueValueType>& p) const {
+    const EncodedKey& operator() (const std::pair<UniqueKeyType, UniqueValueType>& p) const {
         return std::get<0>(p.first);
     }
 
     const UniqueKeyType& mapKey(const std::pair<UniqueKeyType, UniqueValueType>& p) const {
         return p.first;
     }
+
+    /**
+     * @brief Smallest map key with the given index key
+     */
+    static UniqueKeyType first(const EncodedKey& key) {
+        return std::make_tuple(key, 0);
+    }
+
+    /**
+     * @brief Largest map key with the given index key
+     */
+    static UniqueKeyType last(const EncodedKey& key) {
+        return std::make_tuple(key, std::numeric_limits<uint64_t>::max());
+    }
 };
 
 template<>
@@ -126,13 +193,21 @@ template<>
 struct KeyOf<NonUniqueMap> {
     using type = NonUniqueKeyType;
 
-    const KeyType& operator() (const NonUniqueKeyType& p) const {
+    const EncodedKey& operator() (const NonUniqueKeyType& p) const {
         return std::get<0>(p);
     }
 
     const NonUniqueKeyType& mapKey(const NonUniqueKeyType& k) const {
         return k;
     }
+
+    static NonUniqueKeyType first(const EncodedKey& key) {
+        return std::make_tuple(key, 0, key_t{0});
+    }
+
+    static NonUniqueKeyType last(const EncodedKey& key) {
+        return std::make_tuple(key, std::numeric_limits<uint64_t>::max(), key_t{std::numeric_limits<uint64_t>::max()});
+    }
 };
 
 template<>
@@ -150,15 +225,40 @@ struct ValidTo<NonUniqueMap> {
 };
 
 class IteratorImpl {
+    mutable KeyType mKey;
+    mutable bool mKeyDecoded = false;
 public:
     virtual ~IteratorImpl();
     virtual bool done() const = 0;
     virtual void next() = 0;
-    virtual const KeyType& key() const = 0;
+    /**
+     * @brief Encoded key of the current position
+     */
+    virtual const EncodedKey& encodedKey() const = 0;
+    /**
+     * @brief Moves the iterator to the first entry not past the given key
+     *
+     * For forward iterators this is the first entry not smaller than the key, for backward iterators the last entry
+     * not greater than the key.
+     */
+    virtual void seek(const EncodedKey& key) = 0;
+    /**
+     * @brief Key of the current position
+     *
+     * The key is only decoded on the first access after the iterator moved.
+     */
+    const KeyType& key() const;
     virtual ValueType value() const = 0;
     virtual IteratorDirection direction() const = 0;
     virtual void init() = 0;
     virtual IteratorImpl* copy() const = 0;
+protected:
+    /**
+     * @brief Has to be called by implementations whenever the iterator moved
+     */
+    void keyChanged() {
+        mKeyDecoded = false;
+    }
 };
 
 class CacheIteratorImpl : public IteratorImpl {
@@ -183,8 +283,11 @@ public:
         void next() {
             mImpl->next();
         }
-        const KeyType& key() const {
-            return mImpl->key();
+        void seek(const EncodedKey& key) {
+            mImpl->seek(key);
+        }
+        const EncodedKey& encodedKey() const {
+            return mImpl->encodedKey();
         }
         ValueType value() const {
             return mImpl->value();
@@ -203,21 +306,30 @@ public:
         using iterator = Iter;
     private:
         IteratorDirection mDirection;
+        Cache* mCache;
         iterator iter;
         iterator end;
+        KeyBound mBound;
     public:
-        StdIter(IteratorDirection direction, iterator begin, iterator end)
+        StdIter(IteratorDirection direction, Cache& cache, iterator begin, iterator end, const KeyBound& bound)
             : mDirection(direction)
+            , mCache(&cache)
             , iter(begin)
             , end(end)
+            , mBound(bound)
         {}
         virtual bool done() const override {
-            return iter == end;
+            return iter == end || !mBound.contains(iter->first);
         }
         virtual void next() override {
             ++iter;
+            keyChanged();
+        }
+        virtual void seek(const EncodedKey& key) override {
+            keyChanged();
+            reposition(*mCache, iter, key);
         }
-        virtual const KeyType& key() const override {
+        virtual const EncodedKey& encodedKey() const override {
             return iter->first;
         }
         virtual ValueType value() const override {
@@ -232,7 +344,7 @@ public:
 
         virtual void init() override {}
         virtual IteratorImpl* copy() const override {
-            return new StdIter(mDirection, iter, end);
+            return new StdIter(mDirection, *mCache, iter, end, mBound);
         }
     };
 
@@ -264,63 +376,150 @@ public:
         KeyOf<Map> mKeyOf;
         ValueOf<Map> mValueOf;
         ValidTo<Map> mValidTo;
+        Map* mMap;
         typename Map::iterator mapIter;
         typename Map::iterator mapEnd;
         std::shared_ptr<TreeCleaner<Map>> cleaner;
+        KeyBound mBound;
+        /// Key of the entry the iterator stepped from to reach the current entry
+        EncodedKey mPredecessor;
+        /// Whether the current entry was reached by stepping from mPredecessor
+        bool mHasPredecessor = false;
     public:
-        BaseIterator(const commitmanager::SnapshotDescriptor& snapshot, typename Map::iterator iter, Map& map)
+        /**
+         * @brief Number of entries a seek steps over before descending from the root again
+         */
+        static constexpr unsigned SEEK_STEPS = 16;
+
+        BaseIterator(const commitmanager::SnapshotDescriptor& snapshot,
+                typename Map::iterator iter,
+                Map& map,
+                const KeyBound& bound)
             : mSnapshot(snapshot)
+            , mMap(&map)
             , mapIter(iter)
             , cleaner(std::make_shared<TreeCleaner<Map>>(map))
+            , mBound(bound)
         {
         }
         virtual void init() override {
             while (this->mapIter != this->mapEnd) {
+                if (this->pastBound()) {
+                    break;
+                }
                 auto v = this->validTo();
                 if (v < this->mSnapshot.lowestActiveVersion()) {
                     this->cleaner->add(mKeyOf.mapKey(*this->mapIter));
                 } else if (v == std::numeric_limits<uint64_t>::max() || !this->mSnapshot.inReadSet(v)) {
                     break;
                 }
-                forward();
+                step();
             }
         }
     public:
         virtual bool done() const  override {
             return mapIter == mapEnd;
         }
-        virtual const KeyType& key() const override {
+        virtual const EncodedKey& encodedKey() const override {
             return mKeyOf(*mapIter);
         }
         virtual ValueType value() const override {
             return mValueOf(*mapIter);
         }
+        virtual void seek(const EncodedKey& key) override {
+            this->keyChanged();
+            if (!mBound.contains(key)) {
+                mapIter = mapEnd;
+                return;
+            }
+            if (mapIter == mapEnd || !before(mKeyOf(*mapIter), key)) {
+                // The current entry is the target if the entry it was reached from lies before the key
+                if (mapIter == mapEnd || !mHasPredecessor || !before(mPredecessor, key)) {
+                    mHasPredecessor = false;
+                    reposition(key);
+                }
+                init();
+                return;
+            }
+            // Step over the next entries first, as long as they are before the key the current leaf is reused
+            unsigned steps = 0;
+            while (mapIter != mapEnd && before(mKeyOf(*mapIter), key)) {
+                if (++steps > SEEK_STEPS) {
+                    mHasPredecessor = false;
+                    reposition(key);
+                    break;
+                }
+                step();
+            }
+            init();
+        }
         virtual void next() override {
-            this->forward();
+            this->keyChanged();
+            this->step();
             while (this->mapIter != this->mapEnd) {
+                if (this->pastBound()) {
+                    break;
+                }
                 auto v = this->validTo();
                 if (v < this->mSnapshot.lowestActiveVersion()) {
                     this->cleaner->add(mKeyOf.mapKey(*this->mapIter));
                 } else if (v == std::numeric_limits<uint64_t>::max() || !this->mSnapshot.inReadSet(v)) {
                     break;
                 }
-                this->forward();
+                this->step();
             }
         }
     protected:
         uint64_t validTo() const {
             return mValidTo(*mapIter);
         }
+        /**
+         * @brief Stops the iterator if the current entry is outside of the bound
+         *
+         * Entries past the bound are never forwarded over, so no leaf beyond the range gets read.
+         */
+        bool pastBound() {
+            if (mBound.contains(mKeyOf(*mapIter))) {
+                return false;
+            }
+            mapIter = mapEnd;
+            return true;
+        }
+        /**
+         * @brief Moves to the next entry and remembers the key of the entry stepped from
+         *
+         * A later seek to a key after the remembered one but not after the current entry can stay on the current
+         * entry without stepping back or descending the tree again.
+         */
+        void step() {
+            mPredecessor = mKeyOf(*mapIter);
+            mHasPredecessor = true;
+            forward();
+        }
         virtual void forward() = 0;
+        /**
+         * @brief Checks whether the entry key lies before the given key in iteration order
+         */
+        virtual bool before(const EncodedKey& entry, const EncodedKey& key) const = 0;
+        /**
+         * @brief Positions the iterator by descending the tree from the root
+         */
+        virtual void reposition(const EncodedKey& key) = 0;
     };
 
     template<class Map>
     class ForwardIterator : public BaseIterator<Map> {
-        ForwardIterator(const commitmanager::SnapshotDescriptor& snapshot, typename Map::iterator iter , Map& map)
-            : BaseIterator<Map>(snapshot, iter, map) {}
+        ForwardIterator(const commitmanager::SnapshotDescriptor& snapshot,
+                typename Map::iterator iter,
+                Map& map,
+                const KeyBound& bound)
+            : BaseIterator<Map>(snapshot, iter, map, bound) {}
     public:
-        static ForwardIterator* create(const commitmanager::SnapshotDescriptor& snapshot, typename Map::iterator iter , Map& map) {
-            auto res = new ForwardIterator(snapshot, iter, map);
+        static ForwardIterator* create(const commitmanager::SnapshotDescriptor& snapshot,
+                typename Map::iterator iter,
+                Map& map,
+                const KeyBound& bound) {
+            auto res = new ForwardIterator(snapshot, iter, map, bound);
             res->init();
             return res;
         }
@@ -335,14 +534,26 @@ public:
         virtual void forward() override {
             ++this->mapIter;
         }
+        virtual bool before(const EncodedKey& entry, const EncodedKey& key) const override {
+            return entry < key;
+        }
+        virtual void reposition(const EncodedKey& key) override {
+            this->mapIter = findFirst(*this->mMap, key);
+        }
     };
     template<class Map>
     class BackwardIterator : public BaseIterator<Map> {
-        BackwardIterator(const commitmanager::SnapshotDescriptor& snapshot, typename Map::iterator iter, Map& map)
-            : BaseIterator<Map>(snapshot, iter, map) {}
+        BackwardIterator(const commitmanager::SnapshotDescriptor& snapshot,
+                typename Map::iterator iter,
+                Map& map,
+                const KeyBound& bound)
+            : BaseIterator<Map>(snapshot, iter, map, bound) {}
     public:
-        static BackwardIterator* create(const commitmanager::SnapshotDescriptor& snapshot, typename Map::iterator iter, Map& map) {
-           auto res = new BackwardIterator(snapshot, iter, map); 
+        static BackwardIterator* create(const commitmanager::SnapshotDescriptor& snapshot,
+                typename Map::iterator iter,
+                Map& map,
+                const KeyBound& bound) {
+           auto res = new BackwardIterator(snapshot, iter, map, bound);
            res->init();
            return res;
         }
@@ -356,90 +567,167 @@ public:
         virtual void forward() override {
             --this->mapIter;
         }
+        virtual bool before(const EncodedKey& entry, const EncodedKey& key) const override {
+            return entry > key;
+        }
+        virtual void reposition(const EncodedKey& key) override {
+            this->mapIter = findLast(*this->mMap, key);
+        }
     };
+public: // helpers
+    /**
+     * @brief First entry of the map not smaller than the key
+     */
+    template<class Map>
+    static typename Map::iterator findFirst(Map& map, const EncodedKey& key) {
+        return map.find(KeyOf<Map>::first(key));
+    }
+    /**
+     * @brief Last entry of the map not greater than the key
+     */
+    template<class Map>
+    static typename Map::iterator findLast(Map& map, const EncodedKey& key) {
+        KeyOf<Map> keyOf;
+        auto end = map.end();
+        auto iter = map.find_last_smaller_equal(KeyOf<Map>::last(key));
+        while (iter != end && keyOf(*iter) > key) {
+            --iter;
+        }
+        return iter;
+    }
+    static void reposition(Cache& cache, Cache::iterator& iter, const EncodedKey& key) {
+        iter = cache.lower_bound(key);
+    }
+    static void reposition(Cache& cache, std::reverse_iterator<Cache::iterator>& iter, const EncodedKey& key) {
+        iter = std::reverse_iterator<Cache::iterator>(cache.upper_bound(key));
+    }
 protected:
     const commitmanager::SnapshotDescriptor& mSnapshot;
 public:
     BdTree(const commitmanager::SnapshotDescriptor& snapshot) : mSnapshot(snapshot) {}
     virtual ~BdTree();
-    virtual bool insert(const KeyType& key, const ValueType& value) = 0;
-    virtual void revertInsert(const KeyType& key, ValueType value) = 0;
-    virtual bool erase(const KeyType& key, const ValueType& value) = 0;
-    virtual void revertErase(const KeyType& key, ValueType value) = 0;
-    virtual Iterator lower_bound(const KeyType& key) = 0;
-    virtual Iterator reverse_lower_bound(const KeyType& key) = 0;
+    virtual bool insert(const EncodedKey& key, const ValueType& value) = 0;
+    virtual void revertInsert(const EncodedKey& key, ValueType value) = 0;
+    virtual bool erase(const EncodedKey& key, const ValueType& value) = 0;
+    virtual void revertErase(const EncodedKey& key, ValueType value) = 0;
+    virtual std::unique_ptr<IteratorImpl> lower_bound(const EncodedKey& key, const KeyBound& bound) = 0;
+    virtual std::unique_ptr<IteratorImpl> reverse_lower_bound(const EncodedKey& key, const KeyBound& bound) = 0;
 };
 
 class UniqueBdTree : public BdTree {
-    using IndexCache = bdtree::logical_table_cache<UniqueKeyType, UniqueValueType, BdTreeBackend>;
-    using Map = bdtree::map<UniqueKeyType, UniqueValueType, BdTreeBackend>;
+    using Map = UniqueMap;
 private:
-    IndexCache mCache;
     Map mMap;
-private: // Types
 public:
-    UniqueBdTree(const commitmanager::SnapshotDescriptor& snapshot, BdTreeBackend& backend, bool doInit = false);
-    bool insert(const KeyType& key, const ValueType& value) override;
-    bool erase(const KeyType& key, const ValueType& value) override;
-    virtual void revertInsert(const KeyType& key, ValueType value) override;
-    virtual void revertErase(const KeyType& key, ValueType value) override;
-    virtual Iterator lower_bound(const KeyType& key) override;
-    virtual Iterator reverse_lower_bound(const KeyType& key) override;
+    UniqueBdTree(const commitmanager::SnapshotDescriptor& snapshot,
+            BdTreeBackend& backend,
+            UniqueIndexCache& cache,
+            bool doInit = false);
+    bool insert(const EncodedKey& key, const ValueType& value) override;
+    bool erase(const EncodedKey& key, const ValueType& value) override;
+    virtual void revertInsert(const EncodedKey& key, ValueType value) override;
+    virtual void revertErase(const EncodedKey& key, ValueType value) override;
+    virtual std::unique_ptr<IteratorImpl> lower_bound(const EncodedKey& key, const KeyBound& bound) override;
+    virtual std::unique_ptr<IteratorImpl> reverse_lower_bound(const EncodedKey& key, const KeyBound& bound) override;
 };
 
 class NonUniqueBdTree : public BdTree {
-    using IndexCache = bdtree::logical_table_cache<NonUniqueKeyType, NonUniqueValueType, BdTreeBackend>;
-    using Map = bdtree::map<NonUniqueKeyType, NonUniqueValueType, BdTreeBackend>;
+    using Map = NonUniqueMap;
 private:
-    IndexCache mCache;
     Map mMap;
 public:
-    NonUniqueBdTree(const commitmanager::SnapshotDescriptor& snapshot, BdTreeBackend& backend, bool doInit = false);
-    bool insert(const KeyType& key, const ValueType& value) override;
-    bool erase(const KeyType& key, const ValueType& value) override;
-    virtual void revertInsert(const KeyType& key, ValueType value) override;
-    virtual void revertErase(const KeyType& key, ValueType value) override;
-    virtual Iterator lower_bound(const KeyType& key) override;
-    virtual Iterator reverse_lower_bound(const KeyType& key) override;
+    NonUniqueBdTree(const commitmanager::SnapshotDescriptor& snapshot,
+            BdTreeBackend& backend,
+            NonUniqueIndexCache& cache,
+            bool doInit = false);
+    bool insert(const EncodedKey& key, const ValueType& value) override;
+    bool erase(const EncodedKey& key, const ValueType& value) override;
+    virtual void revertInsert(const EncodedKey& key, ValueType value) override;
+    virtual void revertErase(const EncodedKey& key, ValueType value) override;
+    virtual std::unique_ptr<IteratorImpl> lower_bound(const EncodedKey& key, const KeyBound& bound) override;
+    virtual std::unique_ptr<IteratorImpl> reverse_lower_bound(const EncodedKey& key, const KeyBound& bound) override;
 };
 
+class IndexTables;
+
+/**
+ * @brief Returns a leased backend to the free list of its index
+ */
+struct BackendReleaser {
+    IndexTables* tables;
+    void operator() (BdTreeBackend* backend) const;
+};
+
+using BackendHandle = std::unique_ptr<BdTreeBackend, BackendReleaser>;
+
+/**
+ * @brief Long lived state of one index on a worker thread
+ *
+ * Holds the index tables together with the logical table cache of the
+ * Bd-Tree and a free list of backends. This object lives as long as the
+ * TellDBContext of the thread, so every transaction that opens the index
+ * starts with a warm cache and only binds its own snapshot and client
+ * handle to it.
+ */
+class IndexTables {
+public: // types
+    using IndexDescriptor = store::Schema::IndexMap::mapped_type;
+public: // members
+    IndexDescriptor fields;
+    /**
+     * @brief Types of the indexed columns, used to validate typed keys
+     */
+    std::vector<store::FieldType> fieldTypes;
+    TableData ptrTable;
+    TableData nodeTable;
+    std::unique_ptr<UniqueIndexCache> uniqueCache;
+    std::unique_ptr<NonUniqueIndexCache> nonUniqueCache;
+private:
+    BdTreeNodeCache* mNodeCache;
+    std::vector<std::unique_ptr<BdTreeBackend>> mBackends;
+public:
+    IndexTables(const IndexDescriptor& fields,
+            const store::Record& record,
+            TableData ptrTable,
+            TableData nodeTable,
+            BdTreeNodeCache* nodeCache);
+    ~IndexTables();
+    /**
+     * @brief Takes a backend from the free list (or creates one) and binds it to the given handle
+     */
+    BackendHandle acquireBackend(store::ClientHandle& handle);
+    void releaseBackend(BdTreeBackend* backend);
+};
 
 class IndexWrapper {
 public: // Types
     class Iterator : public IteratorImpl {
     public: // types
-        using TreeIter = tell::db::Iterator;
+        using TreeIter = std::unique_ptr<IteratorImpl>;
         using CacheIter = BdTree::CacheIterator;
     private: // members
         IteratorDirection mDirection;
         TreeIter treeIter;
         CacheIter cacheIter;
         bool readFromCache = false;
-        bool isNull(const std::vector<Field>& entry) const {
-            for (const auto& f : entry) {
-                if (!f.null()) {
-                    return false;
-                }
-            }
-            return true;
-        }
+        size_t mRemaining;
         void doSet() {
             if (cacheIter.done()) { 
                 // In this case we can just iterate over the tree
                 readFromCache = false;
                 return;
             }
-            if (treeIter.done()) {
+            if (treeIter->done()) {
                 assert(cacheIter.operation() == IndexOperation::Insert);
                 readFromCache = true;
                 return;
             }
-            if (cacheIter.value() == treeIter.value()) {
+            if (cacheIter.value() == treeIter->value()) {
                 assert(cacheIter.operation() == IndexOperation::Delete);
-                treeIter.next();
+                treeIter->next();
                 cacheIter.next();
             }
-            if (cacheIter.key() < treeIter.key()) {
+            if (cacheIter.encodedKey() < treeIter->encodedKey()) {
                 readFromCache = true;
             } else {
                 readFromCache = false;
@@ -447,38 +735,60 @@ public: // Types
         }
     public:
         template<class TI, class CI>
-        Iterator(IteratorDirection direction, TI&& treeIter, CI&& cacheIter)
+        Iterator(IteratorDirection direction, TI&& treeIter, CI&& cacheIter, size_t limit)
             : mDirection(direction)
             , treeIter(std::forward<TI>(treeIter))
-            , cacheIter(std::forward<CI>(cacheIter)) 
+            , cacheIter(std::forward<CI>(cacheIter))
+            , mRemaining(limit)
         {
             doSet();
         }
+        Iterator(const Iterator& other)
+            : mDirection(other.mDirection)
+            , treeIter(other.treeIter->copy())
+            , cacheIter(other.cacheIter)
+            , readFromCache(other.readFromCache)
+            , mRemaining(other.mRemaining)
+        {}
     public:
         void init() override {}
         bool done() const override {
-            return treeIter.done() && cacheIter.done();
+            return mRemaining == 0 || (treeIter->done() && cacheIter.done());
+        }
+        void seek(const EncodedKey& key) override {
+            keyChanged();
+            if (mRemaining == 0) {
+                return;
+            }
+            treeIter->seek(key);
+            cacheIter.seek(key);
+            doSet();
         }
         void next() override {
+            keyChanged();
+            if (--mRemaining == 0) {
+                // Do not move the underlying iterators past the last entry
+                return;
+            }
             if (readFromCache) {
                 cacheIter.next();
             } else {
-                treeIter.next();
+                treeIter->next();
             }
             doSet();
         }
-        const KeyType& key() const override {
+        const EncodedKey& encodedKey() const override {
             if (readFromCache) {
-                return cacheIter.key();
+                return cacheIter.encodedKey();
             } else {
-                return treeIter.key();
+                return treeIter->encodedKey();
             }
         }
         ValueType value() const override {
             if (readFromCache) {
                 return cacheIter.value();
             } else {
-                return treeIter.value();
+                return treeIter->value();
             }
         }
         IteratorDirection direction() const override {
@@ -491,16 +801,16 @@ public: // Types
 private:
     crossbow::string mName;
     std::vector<store::Schema::id_t> mFields;
-    std::unique_ptr<BdTreeBackend> mBackend;
+    const std::vector<store::FieldType>* mFieldTypes;
+    BackendHandle mBackend;
     const commitmanager::SnapshotDescriptor& mSnapshot;
     std::unique_ptr<BdTree> mBdTree;
     Cache mCache;
 public:
     IndexWrapper(
             const crossbow::string& name,
-            bool uniqueIndex,
-            const std::vector<store::Schema::id_t>& fields,
-            BdTreeBackend&& backend,
+            IndexTables& tables,
+            store::ClientHandle& handle,
             const commitmanager::SnapshotDescriptor& snapshot,
             bool init = false);
 public: // Modifications
@@ -510,6 +820,12 @@ public: // Modifications
 public: // find
     tell::db::Iterator lower_bound(const KeyType& key);
     tell::db::Iterator reverse_lower_bound(const KeyType& key);
+    tell::db::Iterator lower_bound(const IndexKey& key);
+    tell::db::Iterator reverse_lower_bound(const IndexKey& key);
+    /**
+     * @brief Iterates over a bounded range, in the direction of the range's bound
+     */
+    tell::db::Iterator range(const KeyRange& range);
 public: // commit helper functions
     void writeBack();
     void undo();
@@ -521,28 +837,31 @@ public: // commit helper functions
         mCache = std::forward<C>(c);
     }
 private:
-    std::vector<Field> keyOf(const Tuple& tuple);
+    tell::db::Iterator doLowerBound(const EncodedKey& key, const KeyBound& bound, size_t limit);
+    tell::db::Iterator doReverseLowerBound(const EncodedKey& key, const KeyBound& bound, size_t limit);
+    void checkTypes(const IndexKey& key) const;
+    EncodedKey keyOf(const Tuple& tuple);
 };
 
+using IndexTablesMap = std::unordered_map<crossbow::string, IndexTables*>;
+
 class Indexes {
 public: // types
-    using IndexDescriptor = store::Schema::IndexMap::mapped_type;
-    struct IndexTables {
-        ~IndexTables();
-        IndexDescriptor fields;
-        TableData ptrTable;
-        TableData nodeTable;
-    };
+    using IndexDescriptor = IndexTables::IndexDescriptor;
 private: // members
     std::shared_ptr<store::Table> mCounterTable;
-    std::unordered_map<table_t, std::unordered_map<crossbow::string, IndexTables*>> mIndexes;
+    BdTreeNodeCache* mNodeCache;
+    std::unordered_map<table_t, IndexTablesMap> mIndexes;
 public:
-    Indexes(store::ClientHandle& handle);
+    Indexes(store::ClientHandle& handle, BdTreeNodeCache* nodeCache);
 public:
-    std::unordered_map<crossbow::string, IndexWrapper> openIndexes(
-            const commitmanager::SnapshotDescriptor& snapshot,
-            store::ClientHandle& handle,
-            const store::Table& table);
+    /**
+     * @brief Returns the index tables of the given table
+     *
+     * The index tables are loaded from the storage on first access and kept for the lifetime of the thread. This does
+     * not open the indexes for a transaction, IndexWrapper objects are created lazily by the TableCache.
+     */
+    const IndexTablesMap& indexTables(store::ClientHandle& handle, const store::Table& table);
     std::unordered_map<crossbow::string, IndexWrapper> createIndexes(
             const commitmanager::SnapshotDescriptor& snapshot,
             store::ClientHandle& handle,
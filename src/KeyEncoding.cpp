@@ -0,0 +1,178 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#include "KeyEncoding.hpp"
+
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+using namespace tell::store;
+
+namespace tell {
+namespace db {
+namespace impl {
+
+namespace {
+
+constexpr char ESCAPE = '\x00';
+constexpr char ESCAPED_ZERO = '\xFF';
+constexpr char TERMINATOR = '\x01';
+
+template<class T>
+T readBigEndian(const char*& pos, const char* end) {
+    if (end - pos < static_cast<std::ptrdiff_t>(sizeof(T))) {
+        throw std::invalid_argument("Truncated index key");
+    }
+    T value = 0;
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        value = static_cast<T>((value << 8) | static_cast<uint8_t>(*pos++));
+    }
+    return value;
+}
+
+template<class Signed, class Unsigned>
+Signed readInteger(const char*& pos, const char* end) {
+    constexpr Unsigned signBit = Unsigned(1) << (sizeof(Unsigned) * 8 - 1);
+    return static_cast<Signed>(readBigEndian<Unsigned>(pos, end) ^ signBit);
+}
+
+template<class Float, class Unsigned>
+Float readFloat(const char*& pos, const char* end) {
+    constexpr Unsigned signBit = Unsigned(1) << (sizeof(Unsigned) * 8 - 1);
+    auto bits = readBigEndian<Unsigned>(pos, end);
+    bits = (bits & signBit) ? (bits & ~signBit) : ~bits;
+    Float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+crossbow::string readString(const char*& pos, const char* end) {
+    crossbow::string value;
+    while (pos != end) {
+        auto c = *pos++;
+        if (c != ESCAPE) {
+            value.push_back(c);
+            continue;
+        }
+        if (pos == end) {
+            break;
+        }
+        auto next = *pos++;
+        if (next == TERMINATOR) {
+            return value;
+        }
+        value.push_back(ESCAPE);
+    }
+    throw std::invalid_argument("Truncated index key");
+}
+
+} // anonymous namespace
+
+void appendKeyString(const crossbow::string& value, crossbow::string& key) {
+    for (auto c : value) {
+        key.push_back(c);
+        if (c == ESCAPE) {
+            key.push_back(ESCAPED_ZERO);
+        }
+    }
+    key.push_back(ESCAPE);
+    key.push_back(TERMINATOR);
+}
+
+void encodeField(const Field& field, EncodedKey& key) {
+    switch (field.type()) {
+    case FieldType::NULLTYPE:
+        key.push_back(static_cast<char>(KeyTag::Null));
+        return;
+    case FieldType::SMALLINT:
+        appendKeyInteger(KeyTag::SmallInt, field.value<int16_t>(), key);
+        return;
+    case FieldType::INT:
+        appendKeyInteger(KeyTag::Int, field.value<int32_t>(), key);
+        return;
+    case FieldType::BIGINT:
+        appendKeyInteger(KeyTag::BigInt, field.value<int64_t>(), key);
+        return;
+    case FieldType::FLOAT:
+        appendKeyFloat<float, uint32_t>(KeyTag::Float, field.value<float>(), key);
+        return;
+    case FieldType::DOUBLE:
+        appendKeyFloat<double, uint64_t>(KeyTag::Double, field.value<double>(), key);
+        return;
+    case FieldType::TEXT:
+    case FieldType::BLOB:
+        key.push_back(static_cast<char>(KeyTag::Text));
+        appendKeyString(field.value<crossbow::string>(), key);
+        return;
+    case FieldType::NOTYPE:
+        throw std::invalid_argument("Can not use fields without types in index keys");
+    }
+    assert(false);
+    throw std::runtime_error("This should be unreachable code - something went horribly wrong!!");
+}
+
+EncodedKey encodeKey(const KeyType& key) {
+    EncodedKey res;
+    for (const auto& field : key) {
+        encodeField(field, res);
+    }
+    return res;
+}
+
+KeyType decodeKey(const EncodedKey& key) {
+    KeyType res;
+    auto pos = key.data();
+    auto end = pos + key.size();
+    while (pos != end) {
+        switch (static_cast<KeyTag>(*pos++)) {
+        case KeyTag::Null:
+            res.emplace_back(nullptr);
+            break;
+        case KeyTag::SmallInt:
+            res.emplace_back(readInteger<int16_t, uint16_t>(pos, end));
+            break;
+        case KeyTag::Int:
+            res.emplace_back(readInteger<int32_t, uint32_t>(pos, end));
+            break;
+        case KeyTag::BigInt:
+            res.emplace_back(readInteger<int64_t, uint64_t>(pos, end));
+            break;
+        case KeyTag::Float:
+            res.emplace_back(readFloat<float, uint32_t>(pos, end));
+            break;
+        case KeyTag::Double:
+            res.emplace_back(readFloat<double, uint64_t>(pos, end));
+            break;
+        case KeyTag::Text:
+            res.emplace_back(readString(pos, end));
+            break;
+        default:
+            throw std::invalid_argument("Invalid tag in index key");
+        }
+    }
+    return res;
+}
+
+} // namespace impl
+} // namespace db
+} // namespace tell
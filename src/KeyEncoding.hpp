@@ -0,0 +1,61 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include <telldb/Field.hpp>
+#include <telldb/IndexKey.hpp>
+#include <telldb/Iterator.hpp>
+
+#include <crossbow/string.hpp>
+
+namespace tell {
+namespace db {
+namespace impl {
+
+/**
+ * @brief Binary representation of an index key
+ *
+ * Keys are encoded such that comparing two encoded keys bytewise (memcmp) yields the same order as comparing the
+ * fields one by one. Every field starts with a tag byte (see KeyTag) followed by:
+ *  - integers: big endian with the sign bit flipped
+ *  - floating point numbers: big endian bit pattern, negative numbers with all bits flipped, positive ones with only
+ *    the sign bit flipped. -0.0 is encoded as +0.0. NaNs with the sign bit set sort before -inf, the others after
+ *    +inf.
+ *  - text and blobs (both decode to TEXT fields): the bytes with 0x00 escaped as 0x00 0xFF, terminated by 0x00 0x01
+ *
+ * The encoding of every field is prefix free, so the encoding of a multi column key is the concatenation of its
+ * fields.
+ */
+using EncodedKey = crossbow::string;
+
+/**
+ * @brief Appends the encoding of the field to the key
+ */
+void encodeField(const Field& field, EncodedKey& key);
+
+EncodedKey encodeKey(const KeyType& key);
+
+KeyType decodeKey(const EncodedKey& key);
+
+} // namespace impl
+} // namespace db
+} // namespace tell
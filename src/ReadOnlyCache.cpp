@@ -0,0 +1,187 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#include "ReadOnlyCache.hpp"
+#include "CacheSizeHistory.hpp"
+#include <telldb/TellDB.hpp>
+#include <tellstore/ClientManager.hpp>
+
+namespace tell {
+namespace db {
+
+ReadOnlyTableCache::ReadOnlyTableCache(const tell::store::Table& table,
+        tell::store::ClientHandle& handle,
+        const commitmanager::SnapshotDescriptor& snapshot,
+        crossbow::ChunkMemoryPool& pool,
+        const impl::IndexTablesMap& indexTables)
+    : mTable(table)
+    , mHandle(handle)
+    , mSnapshot(snapshot)
+    , mPool(pool)
+    , mTuples(&pool)
+    , mIndexTables(indexTables)
+{}
+
+ReadOnlyTableCache::~ReadOnlyTableCache() {
+    for (auto& p : mTuples) {
+        delete p.second;
+    }
+}
+
+Future<Tuple> ReadOnlyTableCache::get(key_t key) {
+    auto iter = mTuples.find(key);
+    if (iter != mTuples.end()) {
+        return Future<Tuple>(key, iter->second);
+    }
+    return Future<Tuple>(key, this, mHandle.get(mTable, key.value, mSnapshot));
+}
+
+void ReadOnlyTableCache::multiGet(const std::vector<key_t>& keys, Transaction::TupleList& result) {
+    using Resp = std::pair<size_t, std::shared_ptr<store::GetResponse>>;
+    std::vector<Resp, crossbow::ChunkAllocator<Resp>> responses(&mPool);
+    result.resize(keys.size(), nullptr);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        auto iter = mTuples.find(keys[i]);
+        if (iter != mTuples.end()) {
+            result[i] = iter->second;
+            continue;
+        }
+        responses.emplace_back(i, mHandle.get(mTable, keys[i].value, mSnapshot));
+    }
+    for (auto& resp : responses) {
+        if (!resp.second->waitForResult() && resp.second->error() == store::error::not_found) {
+            continue;
+        }
+        // addTuple keeps the first tuple if the same key was requested more than once
+        result[resp.first] = &addTuple(keys[resp.first], resp.second->get());
+    }
+}
+
+Iterator ReadOnlyTableCache::lower_bound(const crossbow::string& name, const KeyType& key) {
+    return index(name).lower_bound(key);
+}
+
+Iterator ReadOnlyTableCache::reverse_lower_bound(const crossbow::string& name, const KeyType& key) {
+    return index(name).reverse_lower_bound(key);
+}
+
+Iterator ReadOnlyTableCache::lower_bound(const crossbow::string& name, const IndexKey& key) {
+    return index(name).lower_bound(key);
+}
+
+Iterator ReadOnlyTableCache::reverse_lower_bound(const crossbow::string& name, const IndexKey& key) {
+    return index(name).reverse_lower_bound(key);
+}
+
+Iterator ReadOnlyTableCache::range(const crossbow::string& name, const impl::KeyRange& range) {
+    return index(name).range(range);
+}
+
+const Tuple& ReadOnlyTableCache::addTuple(key_t key, std::unique_ptr<tell::store::Tuple> tuple) {
+    auto res = mTuples.emplace(key, nullptr);
+    if (res.second) {
+        res.first->second = new (&mPool) Tuple(mTable.record(), std::move(tuple), mPool);
+    }
+    return *res.first->second;
+}
+
+impl::IndexWrapper& ReadOnlyTableCache::index(const crossbow::string& name) {
+    auto iter = mIndexes.find(name);
+    if (iter != mIndexes.end()) {
+        return iter->second;
+    }
+    auto& tables = *mIndexTables.at(name);
+    return mIndexes.emplace(name, impl::IndexWrapper(name, tables, mHandle, mSnapshot)).first->second;
+}
+
+ReadOnlyCache::ReadOnlyCache(impl::TellDBContext& context,
+        tell::store::ClientHandle& handle,
+        const commitmanager::SnapshotDescriptor& snapshot,
+        crossbow::ChunkMemoryPool& pool)
+    : mContext(context)
+    , mHandle(handle)
+    , mSnapshot(snapshot)
+    , mPool(pool)
+    , mTables(&pool)
+{
+    mTables.reserve(mContext.cacheSizes->tables());
+}
+
+ReadOnlyCache::~ReadOnlyCache() {
+    auto& history = *mContext.cacheSizes;
+    history.recordTables(mTables.size());
+    for (auto& p : mTables) {
+        // Read-only transactions do not tell anything about the number of changes
+        history.recordTable(p.first, p.second->numReads(), history.table(p.first).changes);
+        delete p.second;
+    }
+}
+
+Future<Tuple> ReadOnlyCache::get(table_t tableId, key_t key) {
+    return table(tableId).get(key);
+}
+
+Transaction::TupleList ReadOnlyCache::multiGet(table_t tableId, const std::vector<key_t>& keys) {
+    Transaction::TupleList result(&mPool);
+    table(tableId).multiGet(keys, result);
+    return result;
+}
+
+Iterator ReadOnlyCache::lower_bound(table_t tableId, const crossbow::string& idxName, const KeyType& key) {
+    return table(tableId).lower_bound(idxName, key);
+}
+
+Iterator ReadOnlyCache::reverse_lower_bound(table_t tableId, const crossbow::string& idxName, const KeyType& key) {
+    return table(tableId).reverse_lower_bound(idxName, key);
+}
+
+Iterator ReadOnlyCache::lower_bound(table_t tableId, const crossbow::string& idxName, const IndexKey& key) {
+    return table(tableId).lower_bound(idxName, key);
+}
+
+Iterator ReadOnlyCache::reverse_lower_bound(table_t tableId, const crossbow::string& idxName, const IndexKey& key) {
+    return table(tableId).reverse_lower_bound(idxName, key);
+}
+
+Iterator ReadOnlyCache::range(table_t tableId, const crossbow::string& idxName, const impl::KeyRange& range) {
+    return table(tableId).range(idxName, range);
+}
+
+ReadOnlyTableCache& ReadOnlyCache::table(table_t tableId) {
+    for (auto& p : mTables) {
+        if (p.first == tableId) {
+            return *p.second;
+        }
+    }
+    const auto& t = *mContext.tables.at(tableId);
+    auto cache = new (&mPool) ReadOnlyTableCache(t,
+            mHandle,
+            mSnapshot,
+            mPool,
+            mContext.indexes->indexTables(mHandle, t));
+    cache->reserve(mContext.cacheSizes->table(tableId).reads);
+    mTables.emplace_back(tableId, cache);
+    return *cache;
+}
+
+} // namespace db
+} // namespace tell
@@ -0,0 +1,127 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include <telldb/Types.hpp>
+#include <telldb/Transaction.hpp>
+#include <crossbow/ChunkAllocator.hpp>
+
+#include "FlatMap.hpp"
+#include "Indexes.hpp"
+#include "TupleCache.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+namespace tell {
+namespace store {
+class Table;
+class Tuple;
+} // namespace store
+namespace db {
+namespace impl {
+struct TellDBContext;
+} // namespace impl
+
+/**
+ * @brief Tuples of a table read by a read-only transaction
+ *
+ * A read-only transaction never modifies anything, so the cache keeps neither changes nor the versions of the tuples
+ * it read. Indexes are only opened to be read.
+ */
+class ReadOnlyTableCache : public TupleCache, public crossbow::ChunkObject {
+private: // members
+    const tell::store::Table& mTable;
+    tell::store::ClientHandle& mHandle;
+    const commitmanager::SnapshotDescriptor& mSnapshot;
+    crossbow::ChunkMemoryPool& mPool;
+    FlatMap<key_t, Tuple*> mTuples;
+    const impl::IndexTablesMap& mIndexTables;
+    std::unordered_map<crossbow::string, impl::IndexWrapper> mIndexes;
+public: // Construction and Destruction
+    ReadOnlyTableCache(const tell::store::Table& table,
+            tell::store::ClientHandle& handle,
+            const commitmanager::SnapshotDescriptor& snapshot,
+            crossbow::ChunkMemoryPool& pool,
+            const impl::IndexTablesMap& indexTables);
+    ~ReadOnlyTableCache();
+public: // operations
+    Future<Tuple> get(key_t key);
+    void multiGet(const std::vector<key_t>& keys, Transaction::TupleList& result);
+    Iterator lower_bound(const crossbow::string& idxName, const KeyType& key);
+    Iterator reverse_lower_bound(const crossbow::string& idxName, const KeyType& key);
+    Iterator lower_bound(const crossbow::string& idxName, const IndexKey& key);
+    Iterator reverse_lower_bound(const crossbow::string& idxName, const IndexKey& key);
+    Iterator range(const crossbow::string& idxName, const impl::KeyRange& range);
+    void reserve(size_t reads) {
+        mTuples.reserve(reads);
+    }
+    size_t numReads() const {
+        return mTuples.size();
+    }
+private:
+    const Tuple& addTuple(key_t key, std::unique_ptr<tell::store::Tuple> tuple) override;
+    const Tuple* cachedTuple(key_t key) const override {
+        auto iter = mTuples.find(key);
+        return iter == mTuples.end() ? nullptr : iter->second;
+    }
+    impl::IndexWrapper& index(const crossbow::string& name);
+};
+
+/**
+ * @brief Cache of a read-only transaction
+ *
+ * Replaces the TransactionCache for all reads of a read-only or analytical transaction.
+ */
+class ReadOnlyCache : public crossbow::ChunkObject {
+private: // types
+    using TableEntry = std::pair<table_t, ReadOnlyTableCache*>;
+private: // members
+    impl::TellDBContext& mContext;
+    tell::store::ClientHandle& mHandle;
+    const commitmanager::SnapshotDescriptor& mSnapshot;
+    crossbow::ChunkMemoryPool& mPool;
+    /// Transactions only touch a few tables, a linear search is faster than hashing
+    std::vector<TableEntry, crossbow::ChunkAllocator<TableEntry>> mTables;
+public: // Construction and Destruction
+    ReadOnlyCache(impl::TellDBContext& context,
+            tell::store::ClientHandle& handle,
+            const commitmanager::SnapshotDescriptor& snapshot,
+            crossbow::ChunkMemoryPool& pool);
+    ~ReadOnlyCache();
+public: // operations
+    Future<Tuple> get(table_t table, key_t key);
+    Transaction::TupleList multiGet(table_t table, const std::vector<key_t>& keys);
+    Iterator lower_bound(table_t tableId, const crossbow::string& idxName, const KeyType& key);
+    Iterator reverse_lower_bound(table_t tableId, const crossbow::string& idxName, const KeyType& key);
+    Iterator lower_bound(table_t tableId, const crossbow::string& idxName, const IndexKey& key);
+    Iterator reverse_lower_bound(table_t tableId, const crossbow::string& idxName, const IndexKey& key);
+    Iterator range(table_t tableId, const crossbow::string& idxName, const impl::KeyRange& range);
+private:
+    /**
+     * @brief Returns the cache of the given table, creating it on first access
+     */
+    ReadOnlyTableCache& table(table_t table);
+};
+
+} // namespace db
+} // namespace tell
@@ -0,0 +1,63 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#include <telldb/RetryPolicy.hpp>
+#include <telldb/Exceptions.hpp>
+
+#include <algorithm>
+#include <random>
+
+namespace tell {
+namespace db {
+
+bool RetryPolicy::isConflict(const std::exception& e) {
+    return dynamic_cast<const Conflict*>(&e) != nullptr
+        || dynamic_cast<const Conflicts*>(&e) != nullptr
+        || dynamic_cast<const IndexConflict*>(&e) != nullptr;
+}
+
+bool RetryPolicy::shouldRetry(const std::exception& e, size_t attempt) const {
+    if (attempt >= maxAttempts) {
+        return false;
+    }
+    return ((retryOn & CONFLICT) && dynamic_cast<const Conflict*>(&e) != nullptr)
+        || ((retryOn & CONFLICTS) && dynamic_cast<const Conflicts*>(&e) != nullptr)
+        || ((retryOn & INDEX_CONFLICT) && dynamic_cast<const IndexConflict*>(&e) != nullptr);
+}
+
+std::chrono::microseconds RetryPolicy::backoff(size_t attempt) const {
+    // Every thread runs its own fibers, so a thread local generator needs no synchronization
+    static thread_local std::minstd_rand rng(std::random_device{}());
+    auto bound = initialBackoff.count();
+    for (size_t i = 1; i < attempt && bound < maxBackoff.count(); ++i) {
+        bound *= 2;
+    }
+    bound = std::min(bound, maxBackoff.count());
+    if (bound <= 0) {
+        return std::chrono::microseconds(0);
+    }
+    std::uniform_int_distribution<decltype(bound)> dist(0, bound);
+    return std::chrono::microseconds(dist(rng));
+}
+
+} // namespace db
+} // namespace tell
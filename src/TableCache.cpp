@@ -25,6 +25,7 @@
 #include <telldb/Exceptions.hpp>
 
 #include <boost/lexical_cast.hpp>
+#include <algorithm>
 #include <memory>
 
 namespace tell {
@@ -34,35 +35,30 @@ TableCache::TableCache(const tell::store::Table& table,
         tell::store::ClientHandle& handle,
         const commitmanager::SnapshotDescriptor& snapshot,
         crossbow::ChunkMemoryPool& pool,
+        const impl::IndexTablesMap& indexTables,
         std::unordered_map<crossbow::string, impl::IndexWrapper>&& indexes)
     : mTable(table)
     , mHandle(handle)
     , mSnapshot(snapshot)
     , mPool(pool)
     , mCache(&pool)
+    , mCarried(&pool)
     , mChanges(&pool)
-    , mSchema(&pool)
+    , mRewrites(&pool)
+    , mInFlight(&pool)
+    , mPendingWrites(&pool)
+    , mIndexTables(indexTables)
     , mIndexes(std::move(indexes))
-{
-    id_t currId = 0;
-    const auto& schema = table.record().schema();
-    {
-        const auto& fields = schema.fixedSizeFields();
-        for (const auto& field : fields) {
-            mSchema.emplace(field.name(), currId++);
-        }
-    }
-    {
-        const auto& fields = schema.varSizeFields();
-        for (const auto& field : fields) {
-            mSchema.emplace(field.name(), currId++);
-        }
-    }
-}
+    , mAllIndexesOpen(mIndexes.size() == mIndexTables.size())
+{}
 
 TableCache::~TableCache() {
     for (auto& p : mCache) {
-        delete p.second.first;
+        delete std::get<0>(p.second);
+    }
+    // Carried tuples that were never read again or do not exist anymore
+    for (auto& p : mCarried) {
+        delete std::get<0>(p.second);
     }
     for (auto& p : mChanges) {
         if (std::get<1>(p.second) != Operation::Delete) {
@@ -84,21 +80,79 @@ Future<Tuple> TableCache::get(key_t key) {
     {
         auto iter = mCache.find(key);
         if (iter != mCache.end()) {
-            return Future<Tuple>(key, iter->second.first);
+            return Future<Tuple>(key, std::get<0>(iter->second));
+        }
+    }
+    {
+        auto iter = mCarried.find(key);
+        if (iter != mCarried.end()) {
+            return Future<Tuple>(key, this, std::shared_ptr<store::GetResponse>(std::get<2>(iter->second)));
         }
     }
     return Future<Tuple>(key, this, mHandle.get(mTable, key.value, mSnapshot));
 }
 
+void TableCache::multiGet(const std::vector<key_t>& keys, Transaction::TupleList& result) {
+    using Resp = std::pair<size_t, std::shared_ptr<store::GetResponse>>;
+    std::vector<Resp, crossbow::ChunkAllocator<Resp>> responses(&mPool);
+    result.resize(keys.size(), nullptr);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        auto key = keys[i];
+        auto c = mChanges.find(key);
+        if (c != mChanges.end()) {
+            // Deleted tuples are reported as missing
+            result[i] = std::get<0>(c->second);
+            continue;
+        }
+        auto iter = mCache.find(key);
+        if (iter != mCache.end()) {
+            result[i] = std::get<0>(iter->second);
+            continue;
+        }
+        auto carried = mCarried.find(key);
+        if (carried != mCarried.end()) {
+            responses.emplace_back(i, std::get<2>(carried->second));
+            continue;
+        }
+        responses.emplace_back(i, mHandle.get(mTable, key.value, mSnapshot));
+    }
+    for (auto& resp : responses) {
+        if (!resp.second->waitForResult() && resp.second->error() == store::error::not_found) {
+            continue;
+        }
+        auto key = keys[resp.first];
+        auto iter = mCache.find(key);
+        if (iter != mCache.end()) {
+            // The same key was requested more than once
+            result[resp.first] = std::get<0>(iter->second);
+            continue;
+        }
+        result[resp.first] = &addTuple(key, resp.second->get());
+    }
+}
+
 Iterator TableCache::lower_bound(const crossbow::string& name, const KeyType& key) {
-    return mIndexes.at(name).lower_bound(key);
+    return index(name).lower_bound(key);
 }
 
 Iterator TableCache::reverse_lower_bound(const crossbow::string& name, const KeyType& key) {
-    return mIndexes.at(name).reverse_lower_bound(key);
+    return index(name).reverse_lower_bound(key);
+}
+
+Iterator TableCache::lower_bound(const crossbow::string& name, const IndexKey& key) {
+    return index(name).lower_bound(key);
+}
+
+Iterator TableCache::reverse_lower_bound(const crossbow::string& name, const IndexKey& key) {
+    return index(name).reverse_lower_bound(key);
+}
+
+Iterator TableCache::range(const crossbow::string& name, const impl::KeyRange& range) {
+    return index(name).range(range);
 }
 
 void TableCache::insert(key_t key, const Tuple& tuple) {
+    openAllIndexes();
     auto c = mChanges.find(key);
     if (c == mChanges.end()) {
         if (mCache.count(key) != 0) {
@@ -106,8 +160,14 @@ void TableCache::insert(key_t key, const Tuple& tuple) {
         }
         mChanges.emplace(key, std::make_tuple(new (&mPool) Tuple(tuple), Operation::Insert, false));
     } else if (std::get<1>(c->second) == Operation::Delete) {
-        std::get<1>(c->second) = Operation::Update;
         std::get<0>(c->second) = new (&mPool) Tuple(tuple);
+        if (isWritten(*c)) {
+            // The storage already removed the tuple, it has to be inserted again
+            std::get<1>(c->second) = Operation::Insert;
+            mRewrites.insert(key);
+        } else {
+            std::get<1>(c->second) = Operation::Update;
+        }
     } else {
         throw TupleExistsException(key);
     }
@@ -117,21 +177,29 @@ void TableCache::insert(key_t key, const Tuple& tuple) {
 }
 
 void TableCache::update(key_t key, const Tuple& from, const Tuple& to) {
+    openAllIndexes();
+    // The caller may pass the replaced tuple as from, it is destroyed only after the indexes read it
+    Tuple* replaced = nullptr;
     {
         auto i = mChanges.find(key);
         if (i != mChanges.end()) {
             if (std::get<1>(i->second) == Operation::Delete) {
                 throw TupleDoesNotExist(key);
             }
-            delete std::get<0>(i->second);
+            replaced = std::get<0>(i->second);
             std::get<0>(i->second) = new (&mPool) Tuple(to);
+            if (isWritten(*i)) {
+                // The tuple is already in the storage, even if the transaction inserted it
+                std::get<1>(i->second) = Operation::Update;
+                mRewrites.insert(key);
+            }
             goto END;
         }
     }
     {
         auto i = mCache.find(key);
         if (i != mCache.end()) {
-            if (!i->second.second) {
+            if (!std::get<1>(i->second)) {
                 throw Conflict(key);
             }
         } 
@@ -143,21 +211,30 @@ END:
     for (auto& idx : mIndexes) {
         idx.second.update(key, from, to);
     }
+    delete replaced;
 }
 
 void TableCache::remove(key_t key, const Tuple& tuple) {
+    openAllIndexes();
+    // The caller may pass the removed tuple itself, it is destroyed only after the indexes read it
+    Tuple* removed = nullptr;
     {
         auto i = mChanges.find(key);
         if (i != mChanges.end()) {
             if (std::get<1>(i->second) == Operation::Delete) {
                 throw TupleDoesNotExist(key);
             }
-            delete std::get<0>(i->second);
-            if (std::get<1>(i->second) == Operation::Insert) {
+            removed = std::get<0>(i->second);
+            auto written = isWritten(*i);
+            if (std::get<1>(i->second) == Operation::Insert && !written) {
                 mChanges.erase(i);
             } else {
+                // A written insert has to be removed from the storage as well
                 std::get<0>(i->second) = nullptr;
                 std::get<1>(i->second) = Operation::Delete;
+                if (written) {
+                    mRewrites.insert(key);
+                }
             }
             goto END;
         }
@@ -165,7 +242,7 @@ void TableCache::remove(key_t key, const Tuple& tuple) {
     {
         auto i = mCache.find(key);
         if (i != mCache.end()) {
-            if (!i->second.second) {
+            if (!std::get<1>(i->second)) {
                 throw Conflict(key);
             }
         } 
@@ -177,48 +254,101 @@ END:
     for (auto& idx : mIndexes) {
         idx.second.remove(key, tuple);
     }
+    delete removed;
 }
 
-void TableCache::writeBack() {
-    using Resp = std::shared_ptr<store::ModificationResponse>;
-    using ChangeResp = std::pair<Resp, ChangesMap::iterator>;
-    std::vector<ChangeResp, crossbow::ChunkAllocator<ChangeResp>> responses(&mPool);
-    responses.reserve(mChanges.size());
-    for (auto iter = mChanges.begin(); iter != mChanges.end(); ++iter) {
-        auto& change = *iter;
+void TableCache::issueWriteBack() {
+    mPendingWrites.reserve(mPendingWrites.size() + mChanges.size());
+    for (auto& change : mChanges) {
         bool& didChange = std::get<2>(change.second);
-        if (didChange) continue;
-        auto tuple = std::get<0>(change.second);
-        switch (std::get<1>(change.second)) {
-        case Operation::Insert:
-            responses.emplace_back(std::make_pair(mHandle.insert(mTable, change.first, mSnapshot, *tuple), iter));
-            break;
-        case Operation::Update:
-            responses.emplace_back(std::make_pair(mHandle.update(mTable, change.first, mSnapshot, *tuple), iter));
-            break;
-        case Operation::Delete:
-            responses.emplace_back(std::make_pair(mHandle.remove(mTable, change.first, mSnapshot), iter));
-        }
+        if (didChange && mRewrites.count(change.first) == 0) continue;
+        issueChange(change);
     }
-    bool hadError = false;
-    // we put this into the stack, because in normal case the vector should stay
-    // empty (and we optimise for the normal case). The unique pointer makes sure
-    // that the object gets deleted after moving it into the exception object
-    std::unique_ptr<std::vector<key_t>> conflicts = nullptr;
-    for (auto i = responses.rbegin(); i != responses.rend(); ++i) {
-        if (i->first->error()) {
-            hadError = true;
-            if (conflicts.get() == nullptr) {
-                conflicts.reset(new std::vector<key_t>());
+}
+
+void TableCache::issueWrite(key_t key) {
+    auto i = mChanges.find(key);
+    if (i == mChanges.end()) {
+        // The tuple was inserted and removed again
+        return;
+    }
+    if (mInFlight.count(key) != 0) {
+        // A later modification is marked as rewrite and written on commit
+        return;
+    }
+    if (std::get<2>(i->second) && mRewrites.count(key) == 0) {
+        return;
+    }
+    mInFlight.insert(key);
+    issueChange(*i);
+}
+
+void TableCache::issueChange(ChangesMap::value_type& change) {
+    auto tuple = std::get<0>(change.second);
+    switch (std::get<1>(change.second)) {
+    case Operation::Insert:
+        mPendingWrites.emplace_back(mHandle.insert(mTable, change.first, mSnapshot, *tuple), change.first);
+        break;
+    case Operation::Update:
+        mPendingWrites.emplace_back(mHandle.update(mTable, change.first, mSnapshot, *tuple), change.first);
+        break;
+    case Operation::Delete:
+        mPendingWrites.emplace_back(mHandle.remove(mTable, change.first, mSnapshot), change.first);
+    }
+    // The current state is on its way, only later modifications have to be written again
+    if (!mRewrites.empty()) {
+        mRewrites.erase(change.first);
+    }
+}
+
+std::vector<key_t> TableCache::collectWriteBack(bool wait) {
+    // In the normal case this vector stays empty and does not allocate
+    std::vector<key_t> conflicts;
+    if (!wait) {
+        auto end = std::remove_if(mPendingWrites.begin(), mPendingWrites.end(), [this, &conflicts] (PendingWrite& w) {
+            if (!w.first->done()) {
+                return false;
             }
-            conflicts->push_back(i->second->first);
+            if (w.first->error()) {
+                conflicts.push_back(w.second);
+            } else {
+                std::get<2>(mChanges.at(w.second)) = true;
+            }
+            mInFlight.erase(w.second);
+            return true;
+        });
+        mPendingWrites.erase(end, mPendingWrites.end());
+        return conflicts;
+    }
+    for (auto i = mPendingWrites.rbegin(); i != mPendingWrites.rend(); ++i) {
+        if (i->first->error()) {
+            conflicts.push_back(i->second);
         } else {
-            std::get<2>(i->second->second) = true;
+            std::get<2>(mChanges.at(i->second)) = true;
+        }
+    }
+    mPendingWrites.clear();
+    mInFlight.clear();
+    return conflicts;
+}
+
+bool TableCache::hasUnwrittenChanges() const {
+    if (!mRewrites.empty()) {
+        return true;
+    }
+    for (const auto& change : mChanges) {
+        if (!std::get<2>(change.second)) {
+            return true;
         }
     }
-    if (hadError) {
-        throw Conflicts(std::move(*conflicts));
+    for (const auto& idx : mIndexes) {
+        for (const auto& entry : idx.second.cache()) {
+            if (!std::get<2>(entry.second)) {
+                return true;
+            }
+        }
     }
+    return false;
 }
 
 void TableCache::rollback() {
@@ -237,6 +367,11 @@ void TableCache::rollback() {
     }
 }
 
+void TableCache::reserve(size_t reads, size_t changes) {
+    mCache.reserve(reads);
+    mChanges.reserve(changes);
+}
+
 void TableCache::writeIndexes() {
     for (auto& idx : mIndexes) {
         idx.second.writeBack();
@@ -249,19 +384,77 @@ void TableCache::undoIndexes() {
     }
 }
 
-const Tuple& TableCache::addTuple(key_t key, const tell::store::Tuple& tuple) {
-    auto res = new (&mPool) Tuple(mTable.record(), tuple, mPool);
-    mCache.insert(std::make_pair(key, std::make_pair(res, tuple.isNewest())));
+const Tuple* TableCache::cachedTuple(key_t key) const {
+    auto iter = mCache.find(key);
+    return iter == mCache.end() ? nullptr : std::get<0>(iter->second);
+}
+
+const Tuple& TableCache::addTuple(key_t key, std::unique_ptr<tell::store::Tuple> tuple) {
+    Tuple* res = nullptr;
+    auto version = tuple->version();
+    auto isNewest = tuple->isNewest();
+    auto carried = mCarried.find(key);
+    if (carried != mCarried.end()) {
+        if (std::get<1>(carried->second) == version) {
+            // The previous attempt read the same version, its tuple is already decoded
+            res = std::get<0>(carried->second);
+        } else {
+            delete std::get<0>(carried->second);
+        }
+        mCarried.erase(carried);
+    }
+    if (!res) {
+        res = new (&mPool) Tuple(mTable.record(), std::move(tuple), mPool);
+    }
+    mCache.insert(std::make_pair(key, std::make_tuple(res, isNewest, version)));
     return *res;
 }
 
+void TableCache::carryReads(const TableCache& previous, bool unchanged) {
+    for (const auto& p : previous.mCache) {
+        auto key = p.first;
+        if (mCache.count(key) != 0 || mChanges.count(key) != 0) {
+            continue;
+        }
+        auto tuple = new (&mPool) Tuple(*std::get<0>(p.second), mPool);
+        auto version = std::get<2>(p.second);
+        if (unchanged && std::get<1>(p.second)) {
+            // No transaction committed in between, the snapshot still reads this version
+            mCache.emplace(key, std::make_tuple(tuple, true, version));
+        } else {
+            mCarried.emplace(key, std::make_tuple(tuple, version, mHandle.get(mTable, key.value, mSnapshot)));
+        }
+    }
+}
+
+impl::IndexWrapper& TableCache::index(const crossbow::string& name) {
+    auto iter = mIndexes.find(name);
+    if (iter != mIndexes.end()) {
+        return iter->second;
+    }
+    auto& tables = *mIndexTables.at(name);
+    return mIndexes.emplace(name, impl::IndexWrapper(name, tables, mHandle, mSnapshot)).first->second;
+}
+
+void TableCache::openAllIndexes() {
+    if (mAllIndexesOpen) {
+        return;
+    }
+    for (const auto& idx : mIndexTables) {
+        if (mIndexes.find(idx.first) == mIndexes.end()) {
+            mIndexes.emplace(idx.first, impl::IndexWrapper(idx.first, *idx.second, mHandle, mSnapshot));
+        }
+    }
+    mAllIndexesOpen = true;
+}
+
 Future<Tuple>::Future(key_t key, const Tuple* result)
     : key(key)
     , result(result)
     , cache(nullptr)
 {}
 
-Future<Tuple>::Future(key_t key, TableCache* cache, std::shared_ptr<store::GetResponse>&& response)
+Future<Tuple>::Future(key_t key, TupleCache* cache, std::shared_ptr<store::GetResponse>&& response)
     : key(key)
     , result(nullptr)
     , cache(cache)
@@ -287,8 +480,11 @@ const Tuple& Future<Tuple>::get() {
             msg += " does not exist";
             throw std::range_error(msg.data());
         }
-        auto resp = response->get();
-        result = &cache->addTuple(key, *resp);
+        // Several futures can share the response of a carried read, only the first one takes the tuple
+        result = cache->cachedTuple(key);
+        if (!result) {
+            result = &cache->addTuple(key, response->get());
+        }
         return *result;
     }
 }
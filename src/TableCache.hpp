@@ -26,7 +26,11 @@
 #include <crossbow/ChunkAllocator.hpp>
 
 #include "ChunkUnorderedMap.hpp"
+#include "FlatMap.hpp"
 #include "Indexes.hpp"
+#include "TupleCache.hpp"
+
+#include <unordered_set>
 
 namespace tell {
 namespace store {
@@ -42,44 +46,96 @@ struct TellDBContext;
 
 class Tuple;
 
-class TableCache : public crossbow::ChunkObject {
+class TableCache : public TupleCache, public crossbow::ChunkObject {
 public: // public types
     enum class Operation {
         Insert, Update, Delete
     };
     // last bool is true if the change got written to storage
-    using ChangesMap = ChunkUnorderedMap<key_t, std::tuple<Tuple*, Operation, bool>>;
+    using ChangesMap = FlatMap<key_t, std::tuple<Tuple*, Operation, bool>>;
 private: // private types
-    using id_t = tell::store::Schema::id_t;
-    friend class Future<Tuple>;
+    using PendingWrite = std::pair<std::shared_ptr<store::ModificationResponse>, key_t>;
 private: // members
     const tell::store::Table& mTable;
     tell::store::ClientHandle& mHandle;
     const commitmanager::SnapshotDescriptor& mSnapshot;
     crossbow::ChunkMemoryPool& mPool;
-    ChunkUnorderedMap<key_t, std::pair<Tuple*, bool>> mCache;
+    // tuple read, whether it was the newest version and its version
+    FlatMap<key_t, std::tuple<Tuple*, bool, uint64_t>> mCache;
+    /// Tuples read by a previous attempt of the transaction, with their version and the request validating them
+    ChunkUnorderedMap<key_t, std::tuple<Tuple*, uint64_t, std::shared_ptr<store::GetResponse>>> mCarried;
     ChangesMap mChanges;
-    ChunkUnorderedMap<crossbow::string, id_t> mSchema;
+    using KeySet = std::unordered_set<key_t, std::hash<key_t>, std::equal_to<key_t>, crossbow::ChunkAllocator<key_t>>;
+    /// Written changes that got modified again and have to be written once more
+    KeySet mRewrites;
+    /// Changes sent by issueWrite and not yet collected
+    KeySet mInFlight;
+    /// Modifications sent by issueWriteBack and not yet collected
+    std::vector<PendingWrite, crossbow::ChunkAllocator<PendingWrite>> mPendingWrites;
+    const impl::IndexTablesMap& mIndexTables;
+    /// Indexes opened by this transaction so far
     std::unordered_map<crossbow::string, impl::IndexWrapper> mIndexes;
+    bool mAllIndexesOpen;
 public: // Construction and Destruction
     TableCache(const tell::store::Table& table,
             tell::store::ClientHandle& handle,
             const commitmanager::SnapshotDescriptor& snapshot,
             crossbow::ChunkMemoryPool& pool,
+            const impl::IndexTablesMap& indexTables,
             std::unordered_map<crossbow::string, impl::IndexWrapper>&& indexes);
     ~TableCache();
 public: // operations
     Future<Tuple> get(key_t key);
+    void multiGet(const std::vector<key_t>& keys, Transaction::TupleList& result);
     Iterator lower_bound(const crossbow::string& idxName, const KeyType& key);
     Iterator reverse_lower_bound(const crossbow::string& idxName, const KeyType& key);
+    Iterator lower_bound(const crossbow::string& idxName, const IndexKey& key);
+    Iterator reverse_lower_bound(const crossbow::string& idxName, const IndexKey& key);
+    Iterator range(const crossbow::string& idxName, const impl::KeyRange& range);
     void insert(key_t key, const Tuple& tuple);
     void update(key_t key, const Tuple& from, const Tuple& to);
     void remove(key_t key, const Tuple& tuple);
-    void writeBack();
+    /**
+     * @brief Sends all changes not yet written to the storage without waiting for the responses
+     */
+    void issueWriteBack();
+    /**
+     * @brief Sends the change of the given key to the storage without waiting for the response
+     *
+     * Does nothing if the current state of the change is already written or on its way.
+     */
+    void issueWrite(key_t key);
+    /**
+     * @brief Collects the responses of the changes sent by issueWriteBack or issueWrite
+     *
+     * Marks every successful change as written.
+     *
+     * @param wait Whether to wait for all responses or to only collect the ones already received
+     * @return The keys of all changes that conflicted
+     */
+    std::vector<key_t> collectWriteBack(bool wait = true);
     void rollback();
+    /**
+     * @brief Whether a change or an index update still has to be written to the storage
+     */
+    bool hasUnwrittenChanges() const;
+    /**
+     * @brief Takes over the tuples read by a previous attempt of the transaction
+     *
+     * @param previous The table cache of the previous attempt
+     * @param unchanged Whether the snapshot reads exactly the same versions as the one of the previous attempt
+     */
+    void carryReads(const TableCache& previous, bool unchanged);
     void writeIndexes();
     void undoIndexes();
+    /**
+     * @brief Sizes the caches for the given number of reads and changes
+     */
+    void reserve(size_t reads, size_t changes);
 public: // state access
+    size_t numReads() const {
+        return mCache.size();
+    }
     const ChangesMap& changes() const {
         return mChanges;
     }
@@ -90,7 +146,25 @@ public: // state access
         return mIndexes;
     }
 private:
-    const Tuple& addTuple(key_t key, const tell::store::Tuple& tuple);
+    const Tuple& addTuple(key_t key, std::unique_ptr<tell::store::Tuple> tuple) override;
+    const Tuple* cachedTuple(key_t key) const override;
+    /**
+     * @brief Whether the storage already got an earlier state of the change (or is about to get it)
+     */
+    bool isWritten(const ChangesMap::value_type& change) const {
+        return std::get<2>(change.second) || (!mInFlight.empty() && mInFlight.count(change.first) != 0);
+    }
+    void issueChange(ChangesMap::value_type& change);
+    /**
+     * @brief Returns the index with the given name, opening it if this did not happen yet
+     */
+    impl::IndexWrapper& index(const crossbow::string& name);
+    /**
+     * @brief Opens all indexes of the table
+     *
+     * Has to be called before a modification, as every index has to see all changes of the transaction.
+     */
+    void openAllIndexes();
 };
 
 } // namespace db
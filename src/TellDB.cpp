@@ -24,17 +24,21 @@
 #include <random>
 #include <boost/lexical_cast.hpp>
 #include "Indexes.hpp"
+#include "UndoLogJanitor.hpp"
+#include "CacheSizeHistory.hpp"
 
 namespace tell {
 namespace db {
 namespace impl {
 
-Indexes* createIndexes(store::ClientHandle& handle) {
-    return new Indexes(handle);
+Indexes* createIndexes(store::ClientHandle& handle, ClientTable& clientTable) {
+    return new Indexes(handle, &clientTable.nodeCache());
 }
 
 TellDBContext::TellDBContext(ClientTable* table)
     : clientTable(table)
+    , logJanitor(new UndoLogJanitor(*table))
+    , cacheSizes(new CacheSizeHistory())
 {}
 
 void TellDBContext::setIndexes(Indexes* idxs) {
@@ -43,6 +47,7 @@ void TellDBContext::setIndexes(Indexes* idxs) {
 
 
 void ClientTable::init(store::ClientHandle& handle) {
+    mNodeCache = std::make_shared<BdTreeNodeCache>();
     std::random_device rd;
     std::uniform_int_distribution<uint64_t> dist;
     store::Schema schema(store::TableType::NON_TRANSACTIONAL);
@@ -78,6 +83,18 @@ void ClientTable::init(store::ClientHandle& handle) {
                     schema)));
 }
 
+void ClientTable::setNodeCacheCapacity(size_t capacity) {
+    mNodeCache->setCapacity(capacity);
+}
+
+NodeCacheStats ClientTable::nodeCacheStats() const {
+    NodeCacheStats stats;
+    stats.hits = mNodeCache->hits();
+    stats.misses = mNodeCache->misses();
+    stats.evictions = mNodeCache->evictions();
+    return stats;
+}
+
 void ClientTable::destroy(store::ClientHandle& handle) {
     // TODO: drop table
     // TODO: delete entry from ClientTable
@@ -21,7 +21,11 @@
  *     Lucas Braun <braunl@inf.ethz.ch>
  */
 #include "TransactionCache.hpp"
+#include "ReadOnlyCache.hpp"
 #include "RemoteCounter.hpp"
+#include "UndoLogJanitor.hpp"
+#include "UndoLogGroup.hpp"
+#include "CacheSizeHistory.hpp"
 
 #include <telldb/TellDB.hpp>
 #include <telldb/ScanQuery.hpp>
@@ -29,6 +33,8 @@
 #include <telldb/Exceptions.hpp>
 #include <tellstore/ClientManager.hpp>
 
+#include <chrono>
+
 using namespace tell::store;
 
 namespace tell {
@@ -36,6 +42,8 @@ namespace db {
 namespace {
 
 constexpr size_t gMaxUndoLogSize = 16*1024;
+/// Chunks of the undo log eager writes may use, the others are left for the log written on commit
+constexpr size_t gMaxEagerLogChunks = std::numeric_limits<uint16_t>::max() / 2;
 
 } // anonymous namespace
 
@@ -65,6 +73,9 @@ uint64_t Counter::next() {
 }
 
 TellDBContext::~TellDBContext() {
+    if (logJanitor->pending() != 0) {
+        LOG_WARN("%1% undo log tuples of finished transactions are left for recovery", logJanitor->pending());
+    }
     for (auto& p : tables) {
         delete p.second;
     }
@@ -73,12 +84,111 @@ TellDBContext::~TellDBContext() {
     }
 }
 
+void TellDBContext::flushUndoLogs(store::ClientHandle& handle) {
+    logJanitor->flush(handle);
+}
+
+Future<table_t> TellDBContext::openTable(store::ClientHandle& handle, const crossbow::string& name) {
+    auto iter = tableNames.find(name);
+    if (iter != tableNames.end()) {
+        auto res = Future<table_t>(nullptr, *this);
+        res.result = iter->second;
+        return res;
+    }
+    return Future<table_t>(handle.getTable(name), *this);
+}
+
+const store::Table& TellDBContext::createTable(store::ClientHandle& handle,
+        const crossbow::string& name,
+        const store::Schema& schema) {
+    auto table = new store::Table(handle.createTable(name, schema));
+    table_t tableId{table->tableId()};
+    tableNames.emplace(name, tableId);
+    tables.emplace(tableId, table);
+    return *table;
+}
+
+table_t TellDBContext::addTable(store::Table table) {
+    table_t res{table.tableId()};
+    if (tables.find(res) == tables.end()) {
+        tableNames.emplace(table.tableName(), res);
+        tables.emplace(res, new store::Table(std::move(table)));
+    }
+    return res;
+}
+
+const store::Record& TellDBContext::record(table_t table) const {
+    return tables.at(table)->record();
+}
+
+Future<table_t>::Future(std::shared_ptr<store::GetTableResponse>&& resp, TellDBContext& context)
+    : resp(resp)
+    , context(context)
+{
+}
+
+bool Future<table_t>::done() const {
+    if (!resp) {
+        return true;
+    }
+    return resp->done();
+}
+
+bool Future<table_t>::wait() const {
+    if (!resp) {
+        return false;
+    }
+    return resp->wait();
+}
+
+table_t Future<table_t>::get() {
+    if (!resp) {
+        return result;
+    }
+    auto table = resp->get();
+    resp = nullptr;
+    result = context.addTable(std::move(table));
+    return result;
+}
+
+namespace impl {
+
+/**
+ * @brief Keys and undo log segments of the eager writes of a transaction
+ */
+struct EagerWriteState : crossbow::ChunkObject {
+    using ResponseList = std::vector<std::shared_ptr<store::ModificationResponse>,
+            crossbow::ChunkAllocator<std::shared_ptr<store::ModificationResponse>>>;
+
+    EagerWriteState(crossbow::ChunkMemoryPool& pool)
+        : queue(&pool)
+        , logged(&pool)
+        , log(&pool)
+    {}
+
+    // size of the tuples modified by the keys in the queue
+    size_t queueBytes = 0;
+    // set once the undo log used up its share of chunks, later modifications are logged on commit
+    bool logFull = false;
+    // modified keys whose undo log is not yet written
+    Transaction::KeyList queue;
+    // modified keys whose undo log is on its way, their changes are sent once it is written
+    Transaction::KeyList logged;
+    // undo log segments on their way
+    ResponseList log;
+};
+
+} // namespace impl
+
 Transaction::Transaction(ClientHandle& handle, TellDBContext& context,
         std::unique_ptr<commitmanager::SnapshotDescriptor> snapshot, TransactionType type)
     : mHandle(handle)
     , mContext(context)
     , mSnapshot(std::move(snapshot))
-    , mCache(new (&mPool) TransactionCache(context, mHandle, *mSnapshot, mPool))
+    , mCache(type != TransactionType::READ_WRITE ? nullptr
+            : new (&mPool) TransactionCache(context, mHandle, *mSnapshot, mPool))
+    , mReadCache(type == TransactionType::READ_WRITE ? nullptr
+            : new (&mPool) ReadOnlyCache(context, mHandle, *mSnapshot, mPool))
     , mType(type)
 {
 }
@@ -88,17 +198,36 @@ crossbow::ChunkMemoryPool& Transaction::pool() {
 }
 
 Transaction::~Transaction() {
+    finish();
+}
+
+void Transaction::finish() {
     if (!mCommitted) {
         rollback();
     }
 }
 
+void Transaction::carryReads(const Transaction& previous) {
+    LOG_ASSERT(previous.mCommitted, "Previous attempt is still running");
+    if (!mCache || !previous.mCache) {
+        return;
+    }
+    mCache->carryReads(*previous.mCache, *previous.mSnapshot);
+}
+
 Future<table_t> Transaction::openTable(const crossbow::string& name) {
-    return mCache->openTable(name);
+    return mContext.openTable(mHandle, name);
 }
 
 table_t Transaction::createTable(const crossbow::string& name, const store::Schema& schema) {
-    return mCache->createTable(name, schema);
+    if (mCache) {
+        return mCache->createTable(name, schema);
+    }
+    // Without a transaction cache there is nothing to write the root nodes of new indexes with
+    if (!schema.indexes().empty()) {
+        throw std::logic_error("Transaction is read only");
+    }
+    return table_t{mContext.createTable(mHandle, name, schema).tableId()};
 }
 
 const tell::store::Schema& Transaction::getSchema(table_t table) {
@@ -134,17 +263,94 @@ Counter Transaction::getCounter(const crossbow::string& name) {
 }
 
 Future<Tuple> Transaction::get(table_t table, key_t key) {
+    if (mReadCache) {
+        return mReadCache->get(table, key);
+    }
     return mCache->get(table, key);
 }
 
+auto Transaction::multiGet(table_t table, const std::vector<key_t>& keys) -> TupleList {
+    if (mReadCache) {
+        return mReadCache->multiGet(table, keys);
+    }
+    return mCache->multiGet(table, keys);
+}
+
 Iterator Transaction::lower_bound(table_t tableId, const crossbow::string& idxName, const KeyType& key) {
+    if (mReadCache) {
+        return mReadCache->lower_bound(tableId, idxName, key);
+    }
     return mCache->lower_bound(tableId, idxName, key);
 }
 
 Iterator Transaction::reverse_lower_bound(table_t tableId, const crossbow::string& idxName, const KeyType& key) {
+    if (mReadCache) {
+        return mReadCache->reverse_lower_bound(tableId, idxName, key);
+    }
+    return mCache->reverse_lower_bound(tableId, idxName, key);
+}
+
+Iterator Transaction::lower_bound(table_t tableId, const crossbow::string& idxName, const IndexKey& key) {
+    if (mReadCache) {
+        return mReadCache->lower_bound(tableId, idxName, key);
+    }
+    return mCache->lower_bound(tableId, idxName, key);
+}
+
+Iterator Transaction::reverse_lower_bound(table_t tableId, const crossbow::string& idxName, const IndexKey& key) {
+    if (mReadCache) {
+        return mReadCache->reverse_lower_bound(tableId, idxName, key);
+    }
     return mCache->reverse_lower_bound(tableId, idxName, key);
 }
 
+IndexScan Transaction::indexScan(table_t tableId,
+        const crossbow::string& idxName,
+        const KeyType& from,
+        size_t limit,
+        size_t prefetch) {
+    KeyRange range(IteratorDirection::Forward, from, limit);
+    auto iter = mReadCache ? mReadCache->range(tableId, idxName, range) : mCache->range(tableId, idxName, range);
+    return IndexScan(*this, tableId, std::move(iter), prefetch);
+}
+
+IndexScan Transaction::indexScan(table_t tableId,
+        const crossbow::string& idxName,
+        const KeyType& from,
+        const KeyType& to,
+        bool inclusive,
+        size_t limit,
+        size_t prefetch) {
+    auto iter = range(tableId, idxName, from, to, inclusive, limit);
+    return IndexScan(*this, tableId, std::move(iter), prefetch);
+}
+
+Iterator Transaction::range(table_t tableId,
+        const crossbow::string& idxName,
+        const KeyType& from,
+        const KeyType& to,
+        bool inclusive,
+        size_t limit) {
+    KeyRange range(IteratorDirection::Forward, from, to, inclusive, limit);
+    if (mReadCache) {
+        return mReadCache->range(tableId, idxName, range);
+    }
+    return mCache->range(tableId, idxName, range);
+}
+
+Iterator Transaction::reverse_range(table_t tableId,
+        const crossbow::string& idxName,
+        const KeyType& from,
+        const KeyType& to,
+        bool inclusive,
+        size_t limit) {
+    KeyRange range(IteratorDirection::Backward, from, to, inclusive, limit);
+    if (mReadCache) {
+        return mReadCache->range(tableId, idxName, range);
+    }
+    return mCache->range(tableId, idxName, range);
+}
+
 Tuple Transaction::newTuple(table_t table) {
     const auto& t = mContext.tables.at(table);
     const auto& rec = t->record();
@@ -183,19 +389,100 @@ void Transaction::insert(table_t table, key_t key, const std::unordered_map<cros
     for (; i < numVarSize + numFixedSize; ++i) {
         setField(i, varSizeFields[i - numFixedSize]);
     }
-    mCache->insert(table, key, tuple);
+    insert(table, key, tuple);
 }
 
 void Transaction::insert(table_t table, key_t key, const Tuple& tuple) {
+    checkWritable();
     mCache->insert(table, key, tuple);
+    modified(table, key, &tuple);
 }
 
 void Transaction::update(table_t table, key_t key, const Tuple& from, const Tuple& to) {
+    checkWritable();
     mCache->update(table, key, from, to);
+    modified(table, key, &to);
 }
 
 void Transaction::remove(table_t table, key_t key, const Tuple& tuple) {
+    checkWritable();
     mCache->remove(table, key, tuple);
+    modified(table, key, nullptr);
+}
+
+void Transaction::checkWritable() const {
+    if (mReadCache) {
+        throw std::logic_error("Transaction is read only");
+    }
+}
+
+void Transaction::modified(table_t table, key_t key, const Tuple* tuple) {
+    if (mEagerWrites && !mEager->logFull) {
+        mEager->queue.emplace_back(table, key);
+        if (mEagerBatchBytes != 0 && tuple) {
+            mEager->queueBytes += tuple->size();
+        }
+        pumpEagerWrites();
+    }
+    if (mFlushBytes != 0 && tuple) {
+        mUnflushedBytes += tuple->size();
+    }
+    if ((mFlushThreshold != 0 && ++mUnflushed >= mFlushThreshold)
+            || (mFlushBytes != 0 && mUnflushedBytes >= mFlushBytes)) {
+        flush();
+    }
+}
+
+void Transaction::pumpEagerWrites() {
+    if (!mEager->log.empty()) {
+        for (auto& resp : mEager->log) {
+            if (!resp->done()) {
+                // The undo log has to be written before the changes it covers are sent
+                mCache->collectWriteBack(false);
+                return;
+            }
+        }
+        for (auto& resp : mEager->log) {
+            __attribute__((unused)) auto res = resp->waitForResult();
+            LOG_ASSERT(res, "Writeback did not succeed");
+        }
+        mEager->log.clear();
+        for (auto& p : mEager->logged) {
+            mCache->issueWrite(p.first, p.second);
+        }
+        mEager->logged.clear();
+    }
+    if (mEager->queue.size() >= mEagerBatchKeys || (mEagerBatchBytes != 0 && mEager->queueBytes >= mEagerBatchBytes)) {
+        // All keys of the batch share one segment
+        UndoLogWriter log(mPool, gMaxUndoLogSize);
+        mCache->undoLog(log, mEager->queue);
+        if (mUndoLogChunks + log.numSegments() >= gMaxEagerLogChunks) {
+            // Keep the remaining chunks for the commit, it logs all changes not yet written
+            mEager->logFull = true;
+        } else {
+            issueUndoLog(log, mEager->log);
+            std::swap(mEager->queue, mEager->logged);
+        }
+        mEager->queue.clear();
+        mEager->queueBytes = 0;
+    }
+    mCache->collectWriteBack(false);
+}
+
+void Transaction::drainEagerWrites() {
+    for (auto& resp : mEager->log) {
+        __attribute__((unused)) auto res = resp->waitForResult();
+        LOG_ASSERT(res, "Writeback did not succeed");
+    }
+    mEager->log.clear();
+    for (auto& p : mEager->logged) {
+        mCache->issueWrite(p.first, p.second);
+    }
+    mEager->logged.clear();
+    // The keys not yet logged are treated like any other change by the write back
+    mEager->queue.clear();
+    mEager->queueBytes = 0;
+    mCache->collectWriteBack();
 }
 
 std::shared_ptr<store::ScanIterator> Transaction::scan(const ScanQuery& scanQuery, store::ScanMemoryManager& memoryManager) {
@@ -217,98 +504,201 @@ std::shared_ptr<store::ScanIterator> Transaction::scan(const ScanQuery& scanQuer
 }
 
 void Transaction::commit() {
+    if (mReadCache) {
+        finishReadOnly();
+        return;
+    }
     writeBack();
     mHandle.commit(*mSnapshot);
     mCommitted = true;
+    releaseUndoLog();
+}
+
+void Transaction::flush() {
+    writeBack();
+    mUnflushed = 0;
+    mUnflushedBytes = 0;
 }
 
 void Transaction::rollback() {
     if (mCommitted) {
         throw std::logic_error("Transaction has already committed");
     }
+    if (mReadCache) {
+        finishReadOnly();
+        return;
+    }
+    // Undo log segments on their way have to arrive before the janitor removes them
+    if (mEager) {
+        for (auto& resp : mEager->log) {
+            resp->wait();
+        }
+    }
     mCache->rollback();
     mHandle.commit(*mSnapshot);
     mCommitted = true;
+    releaseUndoLog();
 }
 
-void Transaction::writeUndoLog(std::pair<size_t, uint8_t*> log) {
-    uint64_t key = mSnapshot->version() & ~(std::numeric_limits<uint64_t>::max() << 48);
-    if (log.first > gMaxUndoLogSize) {
-        if ((log.first / gMaxUndoLogSize) >= static_cast<decltype(log.first)>(std::numeric_limits<uint16_t>::max())) {
-            throw std::runtime_error("Undo Log is too large");
-        }
-        size_t sizeWritten = 0;
-        std::vector<std::shared_ptr<tell::store::ModificationResponse>> responses;
-        responses.reserve((log.first / gMaxUndoLogSize) + 1);
-        for (uint64_t chunkNum = 0; sizeWritten < log.first; ++chunkNum) {
-            auto chunkKey = (key | (chunkNum << 48));
-            auto toWrite = std::min(log.first - sizeWritten, gMaxUndoLogSize);
-            responses.emplace_back(mHandle.insert(mContext.clientTable->txTable(), chunkKey, 0, {
-                        std::make_pair("value", crossbow::string(reinterpret_cast<char*>(log.second) + sizeWritten,
-                                toWrite))
-                    }));
-            sizeWritten += toWrite;
-        }
-        for (auto i = responses.rbegin(); i != responses.rend(); ++i) {
-            __attribute__((unused)) auto res = (*i)->waitForResult();
-            LOG_ASSERT(res, "Writeback did not succeed");
-        }
-    } else {
-        auto resp = mHandle.insert(mContext.clientTable->txTable(), key, 0, {
-                std::make_pair("value", crossbow::string(reinterpret_cast<char*>(log.second), log.first))
-                });
-        __attribute__((unused)) auto res = resp->waitForResult();
+void Transaction::finishReadOnly() {
+    // Nothing was written, so there is neither anything to revert nor an undo log to remove
+    mHandle.commit(*mSnapshot);
+    mCommitted = true;
+}
+
+void Transaction::writeUndoLog(const UndoLogWriter& log) {
+    if (writeGroupedUndoLog(log)) {
+        return;
+    }
+    ResponseList responses(&mPool);
+    responses.reserve(log.numSegments());
+    issueUndoLog(log, responses);
+    for (auto i = responses.rbegin(); i != responses.rend(); ++i) {
+        __attribute__((unused)) auto res = (*i)->waitForResult();
         LOG_ASSERT(res, "Writeback did not succeed");
     }
 }
 
-void Transaction::removeUndoLog(std::pair<size_t, uint8_t*> log) {
+void Transaction::issueUndoLog(const UndoLogWriter& log, ResponseList& responses) {
+    // Segments of an undo log written earlier are kept, the new ones continue their numbering
+    if (mUndoLogChunks + log.numSegments() >= static_cast<size_t>(std::numeric_limits<uint16_t>::max())) {
+        throw std::runtime_error("Undo Log is too large");
+    }
     uint64_t key = mSnapshot->version() & ~(std::numeric_limits<uint64_t>::max() << 48);
-    if (log.first > gMaxUndoLogSize) {
-        if ((log.first / gMaxUndoLogSize) >= static_cast<decltype(log.first)>(std::numeric_limits<uint16_t>::max())) {
-            throw std::runtime_error("Undo Log is too large");
-        }
-        size_t sizeWritten = 0;
-        std::vector<std::shared_ptr<tell::store::ModificationResponse>> responses;
-        responses.reserve((log.first / gMaxUndoLogSize) + 1);
-        for (uint64_t chunkNum = 0; sizeWritten < log.first; ++chunkNum) {
-            auto chunkKey = (key | (chunkNum << 48));
-            auto segSize = std::min(log.first - sizeWritten, gMaxUndoLogSize);
-            responses.emplace_back(mHandle.remove(mContext.clientTable->txTable(), chunkKey, 1));
-            sizeWritten += segSize;
+    const auto& txTable = mContext.clientTable->txTable();
+    for (size_t i = 0; i < log.numSegments(); ++i) {
+        auto chunkKey = (key | ((mUndoLogChunks + i) << 48));
+        responses.emplace_back(mHandle.insert(txTable, chunkKey, 0,
+                    UndoLogTuple(txTable.record(), log.segment(i), log.segmentSize(i))));
+    }
+    mUndoLogChunks += log.numSegments();
+}
+
+bool Transaction::writeGroupedUndoLog(const UndoLogWriter& log) {
+    const auto& config = mContext.clientTable->groupCommitConfig();
+    auto entrySize = sizeof(uint64_t) + sizeof(uint32_t) + log.size();
+    // The log of a flushing transaction consists of several segments kept in its own tuples
+    if (!config.enabled || mFlushThreshold != 0 || mFlushBytes != 0 || mEager || mUndoLogChunks != 0
+            || mUndoLogGroup || entrySize > config.maxBytes) {
+        return false;
+    }
+    auto& openGroup = mContext.openLogGroup;
+    if (openGroup) {
+        if (openGroup->data.size() + entrySize <= config.maxBytes) {
+            mUndoLogGroup = openGroup;
+            mUndoLogGroup->append(mSnapshot->version(), log);
+            if (mUndoLogGroup->members >= config.maxTransactions) {
+                mUndoLogGroup->sealed = true;
+                openGroup = nullptr;
+            }
+            auto group = mUndoLogGroup;
+            group->writtenCond.wait(mHandle.fiber(), [&group] () {
+                return group->written;
+            });
+            return true;
         }
-        for (auto i = responses.rbegin(); i != responses.rend(); ++i) {
-            __attribute__((unused)) auto res = (*i)->waitForResult();
-            LOG_ASSERT(res, "Could not delete undo log");
+        // The log does not fit anymore: Let the leader write the group right away and start a new one
+        openGroup->sealed = true;
+        openGroup = nullptr;
+    }
+
+    uint64_t key = mSnapshot->version() & ~(std::numeric_limits<uint64_t>::max() << 48);
+    auto group = std::make_shared<UndoLogGroup>(key);
+    group->append(mSnapshot->version(), log);
+    openGroup = group;
+    auto deadline = std::chrono::steady_clock::now() + config.window;
+    while (!group->sealed && group->members < config.maxTransactions && std::chrono::steady_clock::now() < deadline) {
+        mHandle.fiber().yield();
+    }
+    group->sealed = true;
+    if (mContext.openLogGroup == group) {
+        mContext.openLogGroup = nullptr;
+    }
+    if (group->members == 1) {
+        // Nobody joined
+        return false;
+    }
+
+    const auto& txTable = mContext.clientTable->txTable();
+    auto resp = mHandle.insert(txTable, group->key, 0,
+            UndoLogTuple(txTable.record(), group->data.data(), group->data.size()));
+    __attribute__((unused)) auto res = resp->waitForResult();
+    LOG_ASSERT(res, "Writeback did not succeed");
+    mContext.clientTable->recordGroupCommit(group->members, group->data.size());
+    group->pending = group->members;
+    group->written = true;
+    group->writtenCond.notify_all();
+    mUndoLogGroup = std::move(group);
+    return true;
+}
+
+void Transaction::releaseUndoLog() {
+    auto& janitor = *mContext.logJanitor;
+    if (mUndoLogGroup) {
+        // The shared record can only be removed after all of its transactions completed
+        if (--mUndoLogGroup->pending == 0) {
+            janitor.enqueue(mUndoLogGroup->key, 1);
         }
-    } else {
-        auto resp = mHandle.remove(mContext.clientTable->txTable(), key, 1);
-        __attribute__((unused)) auto res = resp->waitForResult();
-        LOG_ASSERT(res, "Could not delete undo log");
+        mUndoLogGroup = nullptr;
+    }
+    if (mUndoLogChunks != 0) {
+        uint64_t key = mSnapshot->version() & ~(std::numeric_limits<uint64_t>::max() << 48);
+        janitor.enqueue(key, mUndoLogChunks);
+        mUndoLogChunks = 0;
     }
+    janitor.run(mHandle);
 }
 
 void Transaction::writeBack(bool withIndexes) {
     if (mCommitted) {
         throw std::logic_error("Transaction has already committed");
     }
+    if (!mCache) {
+        // Read-only transactions have nothing to write
+        return;
+    }
+    if (mEager) {
+        drainEagerWrites();
+    }
     if (!mCache->hasChanges()) {
         return;
     }
     if (mType != store::TransactionType::READ_WRITE) {
         throw std::logic_error("Transaction is read only");
     }
-    auto undoLog = mCache->undoLog(withIndexes);
+    UndoLogWriter undoLog(mPool, gMaxUndoLogSize);
+    mCache->undoLog(undoLog, withIndexes);
     writeUndoLog(undoLog);
-    mCache->writeBack();
+    // As soon as the undo log is written data and index changes are independent: The indexes are maintained while
+    // the data changes are in flight.
+    mCache->issueWriteBack();
     if (withIndexes) {
-        mCache->writeIndexes();
+        try {
+            mCache->writeIndexes();
+        } catch (...) {
+            // The outstanding data changes have to be collected, otherwise rollback would not revert them
+            try {
+                mCache->collectWriteBack();
+            } catch (Conflicts&) {
+            }
+            throw;
+        }
     }
-    removeUndoLog(undoLog);
+    mCache->collectWriteBack();
+    // The undo log is removed by the log janitor once the transaction completed
 }
 
 const store::Record& Transaction::getRecord(table_t table) const {
-    return mCache->record(table);
+    return mContext.record(table);
+}
+
+void Transaction::setEagerWrites(bool eagerWrites, size_t batchKeys, size_t batchBytes) {
+    mEagerWrites = eagerWrites;
+    mEagerBatchKeys = std::max<size_t>(batchKeys, 1);
+    mEagerBatchBytes = batchBytes;
+    if (mEagerWrites && !mEager) {
+        mEager.reset(new (&mPool) EagerWriteState(mPool));
+    }
 }
 
 } // namespace db
@@ -23,54 +23,63 @@
 #include "TransactionCache.hpp"
 #include "TableCache.hpp"
 #include "Indexes.hpp"
-#include "FieldSerialize.hpp"
+#include "CacheSizeHistory.hpp"
 #include <telldb/TellDB.hpp>
 #include <telldb/Exceptions.hpp>
 #include <tellstore/ClientManager.hpp>
-#include <crossbow/Serializer.hpp>
+#include <commitmanager/SnapshotDescriptor.hpp>
+
+#include <algorithm>
 
 using namespace tell::store;
 
 namespace tell {
 namespace db {
 using namespace impl;
+namespace {
 
-Future<table_t>::Future(std::shared_ptr<GetTableResponse>&& resp, TransactionCache& cache)
-    : resp(resp)
-    , cache(cache)
-{
-}
-
-bool Future<table_t>::done() const {
-    if (!resp) {
-        return true;
-    }
-    return resp->done();
-}
+/**
+ * Largest range of versions compared when checking whether two snapshots read the same versions
+ */
+constexpr uint64_t gMaxSnapshotCompare = 4096;
 
-bool Future<table_t>::wait() const {
-    if (!resp) {
+/**
+ * @brief Checks whether every version the newer snapshot reads could also be read by the older one
+ *
+ * The version of the older snapshot itself is ignored, its transaction got rolled back.
+ */
+bool readsSameVersions(const commitmanager::SnapshotDescriptor& older, const commitmanager::SnapshotDescriptor& newer) {
+    if (newer.version() - older.baseVersion() > gMaxSnapshotCompare) {
         return false;
     }
-    return resp->wait();
-}
-
-table_t Future<table_t>::get() {
-    if (!resp) {
-        return result;
+    for (auto version = older.baseVersion() + 1; version < newer.version(); ++version) {
+        if (version != older.version() && newer.inReadSet(version) && !older.inReadSet(version)) {
+            return false;
+        }
     }
-    auto table = resp->get();
-    resp = nullptr;
-    result = cache.addTable(std::move(table));
-    return result;
+    return true;
 }
 
+} // anonymous namespace
+
 Iterator TransactionCache::lower_bound(table_t tableId, const crossbow::string& idxName, const KeyType& key) {
-    return mTables[tableId]->lower_bound(idxName, key);
+    return table(tableId).lower_bound(idxName, key);
 }
 
 Iterator TransactionCache::reverse_lower_bound(table_t tableId, const crossbow::string& idxName, const KeyType& key) {
-    return mTables[tableId]->reverse_lower_bound(idxName, key);
+    return table(tableId).reverse_lower_bound(idxName, key);
+}
+
+Iterator TransactionCache::lower_bound(table_t tableId, const crossbow::string& idxName, const IndexKey& key) {
+    return table(tableId).lower_bound(idxName, key);
+}
+
+Iterator TransactionCache::reverse_lower_bound(table_t tableId, const crossbow::string& idxName, const IndexKey& key) {
+    return table(tableId).reverse_lower_bound(idxName, key);
+}
+
+Iterator TransactionCache::range(table_t tableId, const crossbow::string& idxName, const KeyRange& range) {
+    return table(tableId).range(idxName, range);
 }
 
 TransactionCache::TransactionCache(TellDBContext& context,
@@ -82,93 +91,127 @@ TransactionCache::TransactionCache(TellDBContext& context,
     , mSnapshot(snapshot)
     , mPool(pool)
     , mTables(&pool)
-{}
-
-Future<table_t> TransactionCache::openTable(const crossbow::string& name) {
-    auto iter = context.tableNames.find(name);
-    if (iter != context.tableNames.end()) {
-        auto tableId = iter->second;
-        auto res = Future<table_t>(nullptr, *this);
-        res.result.value = tableId.value;
-        if (mTables.find(tableId) == mTables.end()) {
-            const auto& t = *context.tables[res.result];
-            addTable(t, context.indexes->openIndexes(mSnapshot, mHandle, t));
-        }
-        return res;
-    }
-    return Future<table_t>(mHandle.getTable(name), *this);
+{
+    mTables.reserve(context.cacheSizes->tables());
 }
 
 table_t TransactionCache::createTable(const crossbow::string& name, const store::Schema& schema) {
-    auto table = mHandle.createTable(name, schema);
+    const auto& table = context.createTable(mHandle, name, schema);
     table_t tableId{table.tableId()};
-    context.tableNames.emplace(name, tableId);
-    auto cTable = new Table(table);
-    context.tables.emplace(tableId, cTable);
+    auto indexes = context.indexes->createIndexes(mSnapshot, mHandle, table);
     mTables.emplace(tableId,
-            new (&mPool) TableCache(*cTable,
+            new (&mPool) TableCache(table,
                 mHandle,
                 mSnapshot,
                 mPool,
-                context.indexes->createIndexes(mSnapshot, mHandle, table)));
+                context.indexes->indexTables(mHandle, table),
+                std::move(indexes)));
     return tableId;
 }
 
 Future<Tuple> TransactionCache::get(table_t table, key_t key) {
-    auto cache = mTables.at(table);
-    return cache->get(key);
+    return this->table(table).get(key);
+}
+
+Transaction::TupleList TransactionCache::multiGet(table_t table, const std::vector<key_t>& keys) {
+    Transaction::TupleList result(&mPool);
+    this->table(table).multiGet(keys, result);
+    return result;
 }
 
 void TransactionCache::insert(table_t table, key_t key, const Tuple& tuple) {
-    mTables.at(table)->insert(key, tuple);
+    this->table(table).insert(key, tuple);
 }
 
 void TransactionCache::update(table_t table, key_t key, const Tuple& from, const Tuple& to) {
-    mTables.at(table)->update(key, from, to);
+    this->table(table).update(key, from, to);
 }
 
 void TransactionCache::remove(table_t table, key_t key, const Tuple& tuple) {
-    mTables.at(table)->remove(key, tuple);
+    this->table(table).remove(key, tuple);
 }
 
 TransactionCache::~TransactionCache() {
+    auto& history = *context.cacheSizes;
+    history.recordTables(mTables.size());
     for (auto& p : mTables) {
+        history.recordTable(p.first, p.second->numReads(), p.second->changes().size());
         delete p.second;
     }
 }
 
-table_t TransactionCache::addTable(const tell::store::Table& table,
-        std::unordered_map<crossbow::string,
-        impl::IndexWrapper>&& indexes) {
+table_t TransactionCache::addTableCache(const tell::store::Table& table) {
     table_t id { table.tableId() };
-    mTables.emplace(id, new (&mPool) TableCache(table, mHandle, mSnapshot, mPool, std::move(indexes)));
+    const auto& indexTables = context.indexes->indexTables(mHandle, table);
+    auto cache = new (&mPool) TableCache(table,
+            mHandle,
+            mSnapshot,
+            mPool,
+            indexTables,
+            std::unordered_map<crossbow::string, impl::IndexWrapper>());
+    auto sizes = context.cacheSizes->table(id);
+    cache->reserve(sizes.reads, sizes.changes);
+    mTables.emplace(id, cache);
     return id;
 }
 
-table_t TransactionCache::addTable(tell::store::Table table) {
-    auto indexes = context.indexes->openIndexes(mSnapshot, mHandle, table);
-    table_t res{table.tableId()};
-    Table* t = nullptr;
-    auto iter = context.tables.find(res);
-    if (iter == context.tables.end()) {
-        context.tableNames.emplace(table.tableName(), res);
-        auto p = context.tables.emplace(res, new Table(std::move(table)));
-        t = p.first->second;
-    } else {
-        t = iter->second;
+TableCache& TransactionCache::table(table_t id) {
+    auto iter = mTables.find(id);
+    if (iter != mTables.end()) {
+        return *iter->second;
     }
-    return addTable(*t, std::move(indexes));
+    return *mTables.at(addTableCache(*context.tables.at(id)));
 }
 
 void TransactionCache::rollback() {
+    // Changes still on their way have to be marked as written to get reverted
+    for (auto p : mTables) {
+        p.second->collectWriteBack();
+    }
     for (auto p : mTables) {
         p.second->rollback();
     }
+    for (auto p : mTables) {
+        p.second->undoIndexes();
+    }
+}
+
+void TransactionCache::carryReads(const TransactionCache& previous,
+        const commitmanager::SnapshotDescriptor& previousSnapshot) {
+    auto unchanged = readsSameVersions(previousSnapshot, mSnapshot);
+    for (const auto& p : previous.mTables) {
+        auto iter = mTables.find(p.first);
+        if (iter == mTables.end()) {
+            iter = mTables.find(addTableCache(p.second->table()));
+        }
+        iter->second->carryReads(*p.second, unchanged);
+    }
 }
 
-void TransactionCache::writeBack() {
+void TransactionCache::issueWriteBack() {
+    // Send the changes of all tables before waiting for any response
     for (auto p : mTables) {
-        p.second->writeBack();
+        p.second->issueWriteBack();
+    }
+}
+
+void TransactionCache::issueWrite(table_t table, key_t key) {
+    this->table(table).issueWrite(key);
+}
+
+void TransactionCache::collectWriteBack(bool wait) {
+    // Every table has to update its written flags before we can throw, otherwise rollback would miss changes
+    std::vector<key_t> conflicts;
+    for (auto p : mTables) {
+        auto tableConflicts = p.second->collectWriteBack(wait);
+        if (conflicts.empty()) {
+            conflicts = std::move(tableConflicts);
+        } else {
+            conflicts.insert(conflicts.end(), tableConflicts.begin(), tableConflicts.end());
+        }
+    }
+    if (!conflicts.empty()) {
+        throw Conflicts(std::move(conflicts));
     }
 }
 
@@ -180,49 +223,90 @@ void TransactionCache::writeIndexes() {
 
 bool TransactionCache::hasChanges() const {
     for (const auto& t : mTables) {
-        if (t.second->changes().size() != 0) {
+        if (t.second->hasUnwrittenChanges()) {
             return true;
         }
     }
     return false;
 }
 
-template<class A>
-void TransactionCache::applyForLog(A& ar, bool withIndexes) const {
+void TransactionCache::undoLog(UndoLogWriter& log, bool withIndexes) const {
+    uint64_t numTables = 0;
+    for (const auto& t : mTables) {
+        if (t.second->hasUnwrittenChanges()) {
+            ++numTables;
+        }
+    }
+    log.writeNumTables(numTables);
+
+    std::vector<uint64_t, crossbow::ChunkAllocator<uint64_t>> keys(&mPool);
     for (const auto& t : mTables) {
-        ar & t.first;
         const auto& cs = t.second->changes();
-        uint32_t numChanges = cs.size();
-        ar & numChanges;
+        if (!t.second->hasUnwrittenChanges()) {
+            continue;
+        }
+        // Changes written by an earlier flush are already part of the log
+        keys.clear();
+        keys.reserve(cs.size());
         for (const auto& c : cs) {
-            ar & c.first;
+            if (!std::get<2>(c.second)) {
+                keys.push_back(c.first.value);
+            }
         }
-        if (withIndexes) {
-            const auto& indexes = t.second->indexes();
-            ar & indexes.size();
-            for (const auto& idx : indexes) {
-                ar & idx.first;
-                ar & idx.second.cache();
+        std::sort(keys.begin(), keys.end());
+        if (!withIndexes) {
+            log.writeTable(t.first.value, keys.data(), keys.size(), 0);
+            continue;
+        }
+        const auto& indexes = t.second->indexes();
+        log.writeTable(t.first.value, keys.data(), keys.size(), indexes.size());
+        for (const auto& idx : indexes) {
+            const auto& cache = idx.second.cache();
+            auto numEntries = std::count_if(cache.begin(), cache.end(), [] (const Cache::value_type& entry) {
+                return !std::get<2>(entry.second);
+            });
+            log.writeIndex(idx.first, static_cast<uint64_t>(numEntries));
+            const EncodedKey* previousKey = nullptr;
+            for (const auto& entry : cache) {
+                if (std::get<2>(entry.second)) {
+                    continue;
+                }
+                log.writeIndexEntry(previousKey, entry.first, static_cast<uint8_t>(std::get<0>(entry.second)),
+                        std::get<1>(entry.second), keys.data(), keys.size());
+                previousKey = &entry.first;
             }
         }
     }
 }
 
-std::pair<size_t, uint8_t*> TransactionCache::undoLog(bool withIndexes) const {
-    crossbow::sizer s;
-    applyForLog(s, withIndexes);
-    auto res = reinterpret_cast<uint8_t*>(mPool.allocate(s.size));
-    crossbow::serializer ser(res);
-    applyForLog(ser, withIndexes);
-    ser.buffer.release();
-    return std::make_pair(s.size, res);
-}
+void TransactionCache::undoLog(UndoLogWriter& log, Transaction::KeyList& keys) const {
+    using Entry = Transaction::KeyList::value_type;
+    std::sort(keys.begin(), keys.end(), [] (const Entry& lhs, const Entry& rhs) {
+        return std::make_pair(lhs.first.value, lhs.second.value) < std::make_pair(rhs.first.value, rhs.second.value);
+    });
+    keys.erase(std::unique(keys.begin(), keys.end(), [] (const Entry& lhs, const Entry& rhs) {
+        return lhs.first.value == rhs.first.value && lhs.second.value == rhs.second.value;
+    }), keys.end());
 
-const store::Record& TransactionCache::record(table_t table) const {
-    return mTables.at(table)->table().record();
+    uint64_t numTables = 0;
+    for (auto i = keys.begin(); i != keys.end(); ++i) {
+        if (i == keys.begin() || (i - 1)->first.value != i->first.value) {
+            ++numTables;
+        }
+    }
+    log.writeNumTables(numTables);
+    std::vector<uint64_t, crossbow::ChunkAllocator<uint64_t>> tableKeys(&mPool);
+    for (auto i = keys.begin(); i != keys.end();) {
+        auto table = i->first.value;
+        tableKeys.clear();
+        for (; i != keys.end() && i->first.value == table; ++i) {
+            tableKeys.push_back(i->second.value);
+        }
+        // The index changes are logged on commit
+        log.writeTable(table, tableKeys.data(), tableKeys.size(), 0);
+    }
 }
 
-template class Future<table_t>;
 } // namespace db
 } // namespace tell
 
@@ -27,8 +27,9 @@
 #include <crossbow/string.hpp>
 #include <crossbow/ChunkAllocator.hpp>
 
-#include "ChunkUnorderedMap.hpp"
+#include "FlatMap.hpp"
 #include "Indexes.hpp"
+#include "UndoLog.hpp"
 
 namespace tell {
 namespace db {
@@ -39,12 +40,11 @@ struct TellDBContext;
 class TableCache;
 
 class TransactionCache : public crossbow::ChunkObject {
-    friend class Future<table_t>;
     impl::TellDBContext& context;
     store::ClientHandle& mHandle;
     const commitmanager::SnapshotDescriptor& mSnapshot;
     crossbow::ChunkMemoryPool& mPool;
-    ChunkUnorderedMap<table_t, TableCache*> mTables;
+    FlatMap<table_t, TableCache*> mTables;
 public:
     TransactionCache(impl::TellDBContext& context,
             store::ClientHandle& handle,
@@ -52,28 +52,64 @@ public:
             crossbow::ChunkMemoryPool& pool);
     ~TransactionCache();
 public: // Schema operations
-    Future<table_t> openTable(const crossbow::string& name);
     table_t createTable(const crossbow::string& name, const store::Schema& schema);
 public: // Get/Put
     Future<Tuple> get(table_t table, key_t key);
+    Transaction::TupleList multiGet(table_t table, const std::vector<key_t>& keys);
     Iterator lower_bound(table_t tableId, const crossbow::string& idxName, const KeyType& key);
     Iterator reverse_lower_bound(table_t tableId, const crossbow::string& idxName, const KeyType& key);
+    Iterator lower_bound(table_t tableId, const crossbow::string& idxName, const IndexKey& key);
+    Iterator reverse_lower_bound(table_t tableId, const crossbow::string& idxName, const IndexKey& key);
+    Iterator range(table_t tableId, const crossbow::string& idxName, const impl::KeyRange& range);
     void insert(table_t table, key_t key, const Tuple& tuple);
     void update(table_t table, key_t key, const Tuple& from, const Tuple& to);
     void remove(table_t table, key_t key, const Tuple& tuple);
 public:
-    std::pair<size_t, uint8_t*> undoLog(bool withIndexes = true) const;
-    void writeBack();
+    /**
+     * @brief Writes the undo log of all changes (and index changes) of the transaction
+     */
+    void undoLog(impl::UndoLogWriter& log, bool withIndexes = true) const;
+    /**
+     * @brief Writes the undo log of the given keys (without index changes)
+     *
+     * Sorts the keys and removes duplicates.
+     */
+    void undoLog(impl::UndoLogWriter& log, Transaction::KeyList& keys) const;
+    /**
+     * @brief Sends the changes of all tables to the storage without waiting for the responses
+     */
+    void issueWriteBack();
+    /**
+     * @brief Sends the change of the given key to the storage without waiting for the response
+     */
+    void issueWrite(table_t table, key_t key);
+    /**
+     * @brief Collects the responses of the changes sent by issueWriteBack or issueWrite
+     *
+     * @param wait Whether to wait for all responses or to only collect the ones already received
+     * @throws Conflicts If a change of any table conflicted (with the conflicting keys of all tables)
+     */
+    void collectWriteBack(bool wait = true);
     void writeIndexes();
     void rollback();
+    /**
+     * @brief Takes over the tuples read by a previous attempt of the transaction
+     *
+     * Tuples are reused right away if the snapshot reads exactly the same versions as the
+     * previous one. Otherwise they are requested again in one batch and only reused (without
+     * decoding) if the version did not change.
+     */
+    void carryReads(const TransactionCache& previous, const commitmanager::SnapshotDescriptor& previousSnapshot);
 public: // Helpers
-    const store::Record& record(table_t table) const;
     bool hasChanges() const;
-    template<class A>
-    void applyForLog(A& ar, bool withIndexes) const;
 private:
-    table_t addTable(const tell::store::Table& table, std::unordered_map<crossbow::string, impl::IndexWrapper>&& indexes);
-    table_t addTable(tell::store::Table table);
+    /**
+     * @brief Returns the cache of the given table, creating it on first access
+     *
+     * Table caches are only created when the transaction reads or modifies the table, opening it is not enough.
+     */
+    TableCache& table(table_t id);
+    table_t addTableCache(const tell::store::Table& table);
 };
 
 } // namespace db
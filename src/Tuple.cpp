@@ -70,39 +70,159 @@ Field deserialize(const char* data, tell::store::FieldType type, const char* fie
     return false;
 }
 
+template<class T>
+bool readFixedSize(const tell::store::Record& record, const char* data, Tuple::id_t id, T& value) {
+    bool isNull = false;
+    auto field = record.data(data, id, isNull);
+    if (isNull) {
+        return false;
+    }
+    LOG_ASSERT(reinterpret_cast<uintptr_t>(field) % alignof(T) == 0u, "Pointer to field must be aligned");
+    value = *reinterpret_cast<const T*>(field);
+    return true;
+}
+
 } // namespace {}
 
 Tuple::Tuple(
         const tell::store::Record& record,
-        const tell::store::Tuple& tuple,
+        std::unique_ptr<tell::store::Tuple> tuple,
         crossbow::ChunkMemoryPool& pool)
     : mRecord(record)
     , mPool(pool)
     , mFields(&mPool)
+    , mData(std::move(tuple))
+    , mRaw(mData->data())
+    , mDecoded(&mPool)
 {
-    int numFields = record.fieldCount();
-    for (int i = 0; i < numFields; ++i) {
-        bool isNull = false;
-        tell::store::FieldType type;
-        auto field = record.data(tuple.data(), id_t(i), isNull, &type);
-        if (isNull) {
-            mFields.emplace_back(nullptr);
-        } else {
-            mFields.emplace_back(deserialize(tuple.data(), type, field));
-        }
-    }
+    auto numFields = record.fieldCount();
+    mFields.resize(numFields);
+    mDecoded.resize(numFields, false);
+}
+
+Tuple::Tuple(const tell::store::Record& record, const char* data, uint32_t size, crossbow::ChunkMemoryPool& pool)
+    : mRecord(record)
+    , mPool(pool)
+    , mFields(&mPool)
+    , mRaw(data)
+    , mRawSize(size)
+    , mDecoded(&mPool)
+{
+    auto numFields = record.fieldCount();
+    mFields.resize(numFields);
+    mDecoded.resize(numFields, false);
 }
 
 Tuple::Tuple(const store::Record& record, crossbow::ChunkMemoryPool& pool)
     : mRecord(record)
     , mPool(pool)
     , mFields(&mPool)
+    , mDecoded(&mPool)
 {
     int numFields = record.fieldCount();
     mFields.resize(numFields);
 }
 
+Tuple::Tuple(const Tuple& other)
+    : mRecord(other.mRecord)
+    , mPool(other.mPool)
+    , mFields(&mPool)
+    , mDecoded(&mPool)
+{
+    if (other.mRawSize != 0 && other.mRaw) {
+        // The record lives in the pool as long as both tuples
+        mFields = other.mFields;
+        mRaw = other.mRaw;
+        mRawSize = other.mRawSize;
+        mDecoded = other.mDecoded;
+    } else {
+        mFields = other.fields();
+    }
+}
+
+Tuple::Tuple(const Tuple& other, crossbow::ChunkMemoryPool& pool)
+    : mRecord(other.mRecord)
+    , mPool(pool)
+    , mFields(other.fields().begin(), other.fields().end(), &pool)
+    , mDecoded(&pool)
+{}
+
+Tuple::Tuple(Tuple&& other)
+    : mRecord(other.mRecord)
+    , mPool(other.mPool)
+    , mFields(std::move(other.mFields))
+    , mData(std::move(other.mData))
+    , mRaw(other.mRaw)
+    , mRawSize(other.mRawSize)
+    , mDecoded(std::move(other.mDecoded))
+{
+    other.mRaw = nullptr;
+}
+
+Tuple::~Tuple() = default;
+
+void Tuple::decode(id_t id) const {
+    bool isNull = false;
+    tell::store::FieldType type;
+    auto field = mRecord.data(mRaw, id, isNull, &type);
+    if (isNull) {
+        mFields[id] = nullptr;
+    } else {
+        mFields[id] = deserialize(mRaw, type, field);
+    }
+    mDecoded[id] = true;
+}
+
+bool Tuple::readField(id_t id, int16_t& value) const {
+    return readFixedSize(mRecord, mRaw, id, value);
+}
+
+bool Tuple::readField(id_t id, int32_t& value) const {
+    return readFixedSize(mRecord, mRaw, id, value);
+}
+
+bool Tuple::readField(id_t id, int64_t& value) const {
+    return readFixedSize(mRecord, mRaw, id, value);
+}
+
+bool Tuple::readField(id_t id, float& value) const {
+    return readFixedSize(mRecord, mRaw, id, value);
+}
+
+bool Tuple::readField(id_t id, double& value) const {
+    return readFixedSize(mRecord, mRaw, id, value);
+}
+
+bool Tuple::readField(id_t id, crossbow::string& value) const {
+    bool isNull = false;
+    auto field = mRecord.data(mRaw, id, isNull);
+    if (isNull) {
+        return false;
+    }
+    LOG_ASSERT(reinterpret_cast<uintptr_t>(field) % alignof(uint32_t) == 0u, "Pointer to field must be aligned");
+    auto offsetData = reinterpret_cast<const uint32_t*>(field);
+    value.assign(mRaw + offsetData[0], offsetData[1] - offsetData[0]);
+    return true;
+}
+
+void Tuple::materialize() const {
+    if (!mRaw) {
+        return;
+    }
+    for (id_t i = 0; i < mFields.size(); ++i) {
+        if (!mDecoded[i]) {
+            decode(i);
+        }
+    }
+    mData.reset();
+    mRaw = nullptr;
+}
+
 size_t Tuple::size() const {
+    if (mRaw && mRawSize != 0) {
+        return mRawSize;
+    }
+    materialize();
     auto result = mRecord.staticSize();
     const auto& schema = mRecord.schema();
     for (decltype(mFields.size()) i = schema.fixedSizeFields().size(); i < mFields.size(); ++i) {
@@ -117,6 +237,11 @@ size_t Tuple::size() const {
 void Tuple::serialize(char* dest) const {
     using namespace tell::store;
 
+    if (mRaw && mRawSize != 0) {
+        memcpy(dest, mRaw, mRawSize);
+        return;
+    }
+    materialize();
     const auto& schema = mRecord.schema();
     if (!schema.allNotNull()) {
         // set bitmap to null
@@ -0,0 +1,55 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include <telldb/Transaction.hpp>
+
+#include <memory>
+
+namespace tell {
+namespace store {
+class Tuple;
+} // namespace store
+namespace db {
+
+/**
+ * @brief Cache of the tuples a transaction read from one table
+ *
+ * Future<Tuple> hands the tuples it receives from the storage to the cache it was created by.
+ */
+class TupleCache {
+    friend class Future<Tuple>;
+public:
+    virtual ~TupleCache() = default;
+protected:
+    /**
+     * @brief Adds a tuple received from the storage to the cache
+     */
+    virtual const Tuple& addTuple(key_t key, std::unique_ptr<tell::store::Tuple> tuple) = 0;
+    /**
+     * @brief Returns the tuple already in the cache for the given key or null
+     */
+    virtual const Tuple* cachedTuple(key_t key) const = 0;
+};
+
+} // namespace db
+} // namespace tell
@@ -0,0 +1,199 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#include "UndoLog.hpp"
+
+#include <crossbow/alignment.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace tell {
+namespace db {
+namespace impl {
+
+void UndoLogWriter::writeVarint(uint64_t value) {
+    char buffer[10];
+    size_t length = 0;
+    while (value >= 0x80u) {
+        buffer[length++] = static_cast<char>((value & 0x7Fu) | 0x80u);
+        value >>= 7;
+    }
+    buffer[length++] = static_cast<char>(value);
+    write(buffer, length);
+}
+
+void UndoLogWriter::write(const char* data, size_t length) {
+    while (length != 0) {
+        if (mSize == mSegments.size() * mSegmentSize) {
+            // The last segment is full
+            mSegments.push_back(reinterpret_cast<char*>(mPool.allocate(mSegmentSize)));
+        }
+        auto offset = mSize - (mSegments.size() - 1) * mSegmentSize;
+        auto toWrite = std::min(length, mSegmentSize - offset);
+        memcpy(mSegments.back() + offset, data, toWrite);
+        mSize += toWrite;
+        data += toWrite;
+        length -= toWrite;
+    }
+}
+
+void UndoLogWriter::writeTable(uint64_t tableId, const uint64_t* keys, size_t numKeys, uint64_t numIndexes) {
+    writeVarint(tableId);
+    writeVarint(numKeys);
+    uint64_t previous = 0;
+    for (size_t i = 0; i < numKeys; ++i) {
+        writeVarint(keys[i] - previous);
+        previous = keys[i];
+    }
+    writeVarint(numIndexes);
+}
+
+void UndoLogWriter::writeIndex(const crossbow::string& name, uint64_t numEntries) {
+    writeVarint(name.size());
+    write(name.data(), name.size());
+    writeVarint(numEntries);
+}
+
+void UndoLogWriter::writeIndexEntry(const crossbow::string* previous, const crossbow::string& key, uint8_t operation,
+        uint64_t tupleKey, const uint64_t* keys, size_t numKeys) {
+    size_t shared = 0;
+    if (previous) {
+        auto maxShared = std::min(previous->size(), key.size());
+        while (shared < maxShared && (*previous)[shared] == key[shared]) {
+            ++shared;
+        }
+    }
+    writeVarint(shared);
+    writeVarint(key.size() - shared);
+    write(key.data() + shared, key.size() - shared);
+
+    auto end = keys + numKeys;
+    auto pos = std::lower_bound(keys, end, tupleKey);
+    if (pos != end && *pos == tupleKey) {
+        writeByte(operation | REFERENCE);
+        writeVarint(static_cast<uint64_t>(pos - keys));
+    } else {
+        writeByte(operation);
+        writeVarint(tupleKey);
+    }
+}
+
+UndoLog UndoLogReader::decode() {
+    auto version = readByte();
+    if (version != UndoLogWriter::FORMAT_VERSION) {
+        throw std::runtime_error("Unknown undo log format version " + std::to_string(version));
+    }
+    UndoLog log;
+    auto numTables = readVarint();
+    log.tables.resize(numTables);
+    for (auto& table : log.tables) {
+        table.tableId = readVarint();
+        auto numChanges = readVarint();
+        table.keys.reserve(numChanges);
+        uint64_t previous = 0;
+        for (uint64_t i = 0; i < numChanges; ++i) {
+            previous += readVarint();
+            table.keys.push_back(previous);
+        }
+        table.indexes.resize(readVarint());
+        for (auto& index : table.indexes) {
+            auto nameLength = readVarint();
+            index.name.assign(read(nameLength), nameLength);
+            auto numEntries = readVarint();
+            index.entries.resize(numEntries);
+            const crossbow::string* previousKey = nullptr;
+            for (auto& entry : index.entries) {
+                auto shared = readVarint();
+                auto suffixLength = readVarint();
+                if (shared != 0 && (!previousKey || shared > previousKey->size())) {
+                    throw std::runtime_error("Corrupt undo log");
+                }
+                entry.key.reserve(shared + suffixLength);
+                if (shared != 0) {
+                    entry.key.assign(previousKey->data(), shared);
+                }
+                entry.key.append(read(suffixLength), suffixLength);
+                previousKey = &entry.key;
+
+                auto flags = readByte();
+                auto value = readVarint();
+                entry.operation = flags & ~UndoLogWriter::REFERENCE;
+                if (flags & UndoLogWriter::REFERENCE) {
+                    if (value >= table.keys.size()) {
+                        throw std::runtime_error("Corrupt undo log");
+                    }
+                    value = table.keys[value];
+                }
+                entry.tupleKey = value;
+            }
+        }
+    }
+    return log;
+}
+
+uint64_t UndoLogReader::readVarint() {
+    uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        auto byte = readByte();
+        value |= static_cast<uint64_t>(byte & 0x7Fu) << shift;
+        if ((byte & 0x80u) == 0) {
+            return value;
+        }
+    }
+    throw std::runtime_error("Corrupt undo log");
+}
+
+uint8_t UndoLogReader::readByte() {
+    return static_cast<uint8_t>(*read(1));
+}
+
+const char* UndoLogReader::read(size_t length) {
+    if (static_cast<size_t>(mEnd - mData) < length) {
+        throw std::runtime_error("Truncated undo log");
+    }
+    auto res = mData;
+    mData += length;
+    return res;
+}
+
+size_t UndoLogTuple::size() const {
+    return crossbow::align(mRecord.staticSize() + mLength, 8u);
+}
+
+void UndoLogTuple::serialize(char* dest) const {
+    // The undo log table has a single blob field
+    const auto& schema = mRecord.schema();
+    if (!schema.allNotNull()) {
+        ::memset(dest, 0, mRecord.headerSize());
+    }
+    auto heapOffset = mRecord.staticSize();
+    *reinterpret_cast<uint32_t*>(dest + mRecord.getFieldMeta(0).offset) = heapOffset;
+    memcpy(dest + heapOffset, mData, mLength);
+    *reinterpret_cast<uint32_t*>(dest + heapOffset - sizeof(uint32_t)) = heapOffset + mLength;
+}
+
+} // namespace impl
+} // namespace db
+} // namespace tell
@@ -0,0 +1,230 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+
+#include <tellstore/AbstractTuple.hpp>
+#include <tellstore/Record.hpp>
+
+#include <crossbow/ChunkAllocator.hpp>
+#include <crossbow/non_copyable.hpp>
+#include <crossbow/string.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace tell {
+namespace db {
+namespace impl {
+
+/**
+ * @brief Builds an undo log in segments that are written to the storage as they are
+ *
+ * The log is written in one pass into segments allocated from the transaction pool. Every segment becomes one undo log
+ * tuple, so the log does not have to be copied again before it is sent.
+ *
+ * The format is:
+ * @code
+ * log    := byte(version) varint(numTables) table*
+ * table  := varint(tableId) varint(numChanges) varint(keyDelta)* varint(numIndexes) index*
+ * index  := varint(nameLength) name varint(numEntries) entry*
+ * entry  := varint(sharedPrefix) varint(suffixLength) suffix byte(flags) varint(value)
+ * @endcode
+ *
+ * The keys of the changes are sorted and stored as the difference to the preceding key (the first one to 0). Index
+ * entries are sorted by their encoded key and only store the bytes not shared with the preceding key. The lowest bit of
+ * the flags byte is the IndexOperation. If the REFERENCE flag is set the value is the position of the tuple key in the
+ * list of changes of the table, otherwise it is the tuple key itself. The version byte is FORMAT_VERSION and changes
+ * whenever the format does, so recovery can tell logs written by older clients apart.
+ *
+ * A transaction flushing its changes before the commit writes one log per flush containing only the changes and index
+ * entries not written before. Its segments continue the chunk numbering of the previous ones.
+ */
+class UndoLogWriter : crossbow::non_copyable, crossbow::non_movable {
+public:
+    /// Flag of an index entry whose value references a change of the table
+    static constexpr uint8_t REFERENCE = 0x80u;
+    /// Version of the log format written at the start of every log
+    static constexpr uint8_t FORMAT_VERSION = 1u;
+
+    UndoLogWriter(crossbow::ChunkMemoryPool& pool, size_t segmentSize)
+        : mPool(pool)
+        , mSegmentSize(segmentSize)
+        , mSegments(&pool)
+    {
+        writeByte(FORMAT_VERSION);
+    }
+
+    void writeVarint(uint64_t value);
+
+    void writeByte(uint8_t value) {
+        write(reinterpret_cast<const char*>(&value), 1);
+    }
+
+    void write(const char* data, size_t length);
+
+    /**
+     * @brief Writes the number of tables, has to come right after the version
+     */
+    void writeNumTables(uint64_t numTables) {
+        writeVarint(numTables);
+    }
+
+    /**
+     * @brief Writes the changes of a table, followed by numIndexes calls to writeIndex
+     *
+     * @param keys The keys of the changed tuples in ascending order
+     */
+    void writeTable(uint64_t tableId, const uint64_t* keys, size_t numKeys, uint64_t numIndexes);
+
+    /**
+     * @brief Writes the header of an index, followed by numEntries calls to writeIndexEntry
+     */
+    void writeIndex(const crossbow::string& name, uint64_t numEntries);
+
+    /**
+     * @brief Writes an index entry
+     *
+     * The tuple key is written as a reference if it is one of the keys of the table.
+     *
+     * @param previous The key of the preceding entry of the index, null for the first entry
+     * @param keys The keys of the changed tuples of the table as passed to writeTable
+     */
+    void writeIndexEntry(const crossbow::string* previous, const crossbow::string& key, uint8_t operation,
+            uint64_t tupleKey, const uint64_t* keys, size_t numKeys);
+
+    /**
+     * @brief Total size of the log in bytes
+     */
+    size_t size() const {
+        return mSize;
+    }
+
+    size_t numSegments() const {
+        return mSegments.size();
+    }
+
+    const char* segment(size_t idx) const {
+        return mSegments[idx];
+    }
+
+    size_t segmentSize(size_t idx) const {
+        return (idx + 1 < mSegments.size() ? mSegmentSize : mSize - idx * mSegmentSize);
+    }
+
+private:
+    crossbow::ChunkMemoryPool& mPool;
+    size_t mSegmentSize;
+    std::vector<char*, crossbow::ChunkAllocator<char*>> mSegments;
+    size_t mSize = 0;
+};
+
+/**
+ * @brief Contents of one undo log
+ */
+struct UndoLog {
+    struct IndexEntry {
+        crossbow::string key;
+        /// Flags of the entry without the REFERENCE flag
+        uint8_t operation;
+        /// Key of the tuple, references to the changes of the table are resolved
+        uint64_t tupleKey;
+    };
+
+    struct Index {
+        crossbow::string name;
+        std::vector<IndexEntry> entries;
+    };
+
+    struct Table {
+        uint64_t tableId;
+        /// Keys of the changed tuples in ascending order
+        std::vector<uint64_t> keys;
+        std::vector<Index> indexes;
+    };
+
+    std::vector<Table> tables;
+};
+
+/**
+ * @brief Decodes undo logs written by UndoLogWriter
+ *
+ * The segments of a log have to be concatenated. A transaction that flushed wrote several logs, their segments can be
+ * concatenated as well and are decoded one after the other.
+ */
+class UndoLogReader {
+public:
+    UndoLogReader(const char* data, size_t length)
+        : mData(data)
+        , mEnd(data + length)
+    {}
+
+    /**
+     * @brief Whether all logs were decoded
+     */
+    bool done() const {
+        return mData == mEnd;
+    }
+
+    /**
+     * @brief Decodes the next log
+     *
+     * @throws std::runtime_error If the log has an unknown format version or is truncated
+     */
+    UndoLog decode();
+
+private:
+    uint64_t readVarint();
+
+    uint8_t readByte();
+
+    const char* read(size_t length);
+
+    const char* mData;
+    const char* mEnd;
+};
+
+/**
+ * @brief Undo log tuple serializing a segment of the log straight into the request
+ */
+class UndoLogTuple : public store::AbstractTuple {
+public:
+    UndoLogTuple(const store::Record& record, const char* data, size_t length)
+        : mRecord(record)
+        , mData(data)
+        , mLength(length)
+    {}
+
+    size_t size() const override;
+
+    void serialize(char* dest) const override;
+
+private:
+    const store::Record& mRecord;
+    const char* mData;
+    size_t mLength;
+};
+
+} // namespace impl
+} // namespace db
+} // namespace tell
@@ -0,0 +1,93 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+
+#include "UndoLog.hpp"
+
+#include <crossbow/infinio/Fiber.hpp>
+#include <crossbow/non_copyable.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+namespace tell {
+namespace db {
+namespace impl {
+
+/**
+ * @brief Undo log record shared by transactions of one thread committing at the same time
+ *
+ * The first transaction reaching its undo log write opens the group and waits for a short window for other
+ * transactions of the same thread to join. It then writes the combined record with a single insert and wakes up all
+ * members.
+ *
+ * The record is stored under the key of the leading transaction with the chunk number set to GROUP_CHUNK. It is a
+ * sequence of entries, each consisting of the version of a member (8 bytes), the size of its undo log (4 bytes) and
+ * the undo log itself. Recovery has to check the version of every entry individually. The record is removed after
+ * the last member completed.
+ */
+struct UndoLogGroup : crossbow::non_copyable, crossbow::non_movable {
+    /// Chunk number marking a shared undo log record
+    static constexpr uint64_t GROUP_CHUNK = std::numeric_limits<uint16_t>::max();
+
+    UndoLogGroup(uint64_t key)
+        : key(key | (GROUP_CHUNK << 48))
+    {}
+
+    void append(uint64_t version, const UndoLogWriter& log) {
+        auto size = static_cast<uint32_t>(log.size());
+        auto offset = data.size();
+        data.resize(offset + sizeof(version) + sizeof(size) + size);
+        auto ptr = data.data() + offset;
+        memcpy(ptr, &version, sizeof(version));
+        ptr += sizeof(version);
+        memcpy(ptr, &size, sizeof(size));
+        ptr += sizeof(size);
+        for (size_t i = 0; i < log.numSegments(); ++i) {
+            memcpy(ptr, log.segment(i), log.segmentSize(i));
+            ptr += log.segmentSize(i);
+        }
+        ++members;
+    }
+
+    /// Key of the shared record
+    uint64_t key;
+    /// Serialized entries of all members
+    std::vector<char> data;
+    /// Number of transactions in the group
+    size_t members = 0;
+    /// Number of members that did not yet complete at the commit manager
+    size_t pending = 0;
+    /// Set as soon as no more transactions may join
+    bool sealed = false;
+    /// Set after the record was written
+    bool written = false;
+    /// Members wait on this until the record is written
+    crossbow::infinio::ConditionVariable writtenCond;
+};
+
+} // namespace impl
+} // namespace db
+} // namespace tell
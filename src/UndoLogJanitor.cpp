@@ -0,0 +1,91 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#include "UndoLogJanitor.hpp"
+
+#include <telldb/TellDB.hpp>
+
+#include <crossbow/logger.hpp>
+
+#include <algorithm>
+
+namespace tell {
+namespace db {
+namespace impl {
+namespace {
+
+/**
+ * @brief Logs the removal if it failed, the response has to be done
+ */
+void checkRemoval(store::ModificationResponse& resp) {
+    if (!resp.waitForResult()) {
+        LOG_ERROR("Could not delete undo log [error = %1%]", resp.error().message());
+    }
+}
+
+} // anonymous namespace
+
+void UndoLogJanitor::enqueue(uint64_t key, uint64_t numChunks) {
+    for (uint64_t chunkNum = 0; chunkNum < numChunks; ++chunkNum) {
+        mQueue.push_back(key | (chunkNum << 48));
+    }
+}
+
+void UndoLogJanitor::run(store::ClientHandle& handle) {
+    mInFlight.erase(std::remove_if(mInFlight.begin(), mInFlight.end(),
+            [](const std::shared_ptr<store::ModificationResponse>& resp) {
+        if (!resp->done()) {
+            return false;
+        }
+        checkRemoval(*resp);
+        return true;
+    }), mInFlight.end());
+
+    if (mQueue.size() < BATCH_SIZE && !mInFlight.empty()) {
+        return;
+    }
+    send(handle);
+}
+
+void UndoLogJanitor::flush(store::ClientHandle& handle) {
+    send(handle);
+    // The removals were issued by other fibers, so poll them instead of blocking on their responses
+    for (auto& resp : mInFlight) {
+        while (!resp->done()) {
+            handle.fiber().yield();
+        }
+        checkRemoval(*resp);
+    }
+    mInFlight.clear();
+}
+
+void UndoLogJanitor::send(store::ClientHandle& handle) {
+    const auto& txTable = mClientTable.txTable();
+    for (auto key : mQueue) {
+        mInFlight.emplace_back(handle.remove(txTable, key, 1));
+    }
+    mQueue.clear();
+}
+
+} // namespace impl
+} // namespace db
+} // namespace tell
@@ -0,0 +1,107 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+
+#include <tellstore/ClientManager.hpp>
+
+#include <crossbow/non_copyable.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace tell {
+namespace db {
+namespace impl {
+
+class ClientTable;
+
+/**
+ * @brief Removes the undo logs of finished transactions of one thread in batches
+ *
+ * A transaction hands its undo log over to the janitor after it completed at the commit manager instead of removing
+ * it synchronously before the commit. The janitor collects the removals and sends them as one batch whenever enough
+ * of them are queued. The batch is sent by whatever transaction of the thread finishes next and nobody waits for the
+ * responses: they are checked by later runs once they arrived.
+ *
+ * As a log is never removed before its transaction completed, a log found during recovery belongs to an in-flight
+ * transaction iff the commit manager does not report the version encoded in its key as completed. Logs of completed
+ * transactions are left-overs of the janitor and can simply be deleted.
+ */
+class UndoLogJanitor : crossbow::non_copyable, crossbow::non_movable {
+public:
+    /**
+     * Number of queued undo log tuples that triggers sending a batch of removals
+     */
+    static constexpr size_t BATCH_SIZE = 64;
+
+    UndoLogJanitor(const ClientTable& clientTable)
+        : mClientTable(clientTable)
+    {}
+
+    /**
+     * @brief Queues the removal of an undo log
+     *
+     * Must only be called after the transaction writing the log completed at the commit manager.
+     *
+     * @param key The key of the first chunk of the log
+     * @param numChunks The number of tuples the log was split into
+     */
+    void enqueue(uint64_t key, uint64_t numChunks);
+
+    /**
+     * @brief Sends the queued removals if a batch is complete and checks the responses of earlier batches
+     *
+     * A partial batch is sent as well if no removal is in flight anymore, so removals do not wait for later
+     * transactions of the thread to fill the batch. Never waits for a response.
+     */
+    void run(store::ClientHandle& handle);
+
+    /**
+     * @brief Sends all queued removals and waits for every removal in flight
+     *
+     * Yields the fiber of the handle until the responses arrived. Failed removals are logged, the logs are then
+     * left for recovery.
+     */
+    void flush(store::ClientHandle& handle);
+
+    /**
+     * @brief Number of undo log tuples queued or in flight
+     */
+    size_t pending() const {
+        return mQueue.size() + mInFlight.size();
+    }
+
+private:
+    void send(store::ClientHandle& handle);
+
+    const ClientTable& mClientTable;
+    /// Keys of the undo log tuples to remove
+    std::vector<uint64_t> mQueue;
+    /// Removals sent but not yet answered
+    std::vector<std::shared_ptr<store::ModificationResponse>> mInFlight;
+};
+
+} // namespace impl
+} // namespace db
+} // namespace tell
@@ -0,0 +1,186 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include "Exceptions.hpp"
+
+#include <tellstore/StdTypes.hpp>
+#include <tellstore/Record.hpp>
+#include <crossbow/string.hpp>
+
+#include <cstdint>
+#include <initializer_list>
+
+namespace tell {
+namespace db {
+
+/**
+ * @brief The storage type of the C++ type T
+ *
+ * Strings can be read from and written to BLOB fields as well, but new fields of a string member are TEXT fields.
+ */
+template<class T>
+struct FieldTypeOf;
+
+template<>
+struct FieldTypeOf<int16_t> {
+    static constexpr store::FieldType value = store::FieldType::SMALLINT;
+};
+
+template<>
+struct FieldTypeOf<int32_t> {
+    static constexpr store::FieldType value = store::FieldType::INT;
+};
+
+template<>
+struct FieldTypeOf<int64_t> {
+    static constexpr store::FieldType value = store::FieldType::BIGINT;
+};
+
+template<>
+struct FieldTypeOf<float> {
+    static constexpr store::FieldType value = store::FieldType::FLOAT;
+};
+
+template<>
+struct FieldTypeOf<double> {
+    static constexpr store::FieldType value = store::FieldType::DOUBLE;
+};
+
+template<>
+struct FieldTypeOf<crossbow::string> {
+    static constexpr store::FieldType value = store::FieldType::TEXT;
+};
+
+namespace impl {
+
+/**
+ * @brief Storage type the C++ type T can be used with besides FieldTypeOf<T> (NOTYPE if there is none)
+ */
+template<class T>
+struct AlternativeFieldType {
+    static constexpr store::FieldType value = store::FieldType::NOTYPE;
+};
+
+template<>
+struct AlternativeFieldType<crossbow::string> {
+    static constexpr store::FieldType value = store::FieldType::BLOB;
+};
+
+/**
+ * @brief Returns the field of the schema with the given id or null if there is none
+ */
+inline const store::Field* fieldOf(const store::Schema& schema, store::Schema::id_t id) {
+    const auto& fixedSize = schema.fixedSizeFields();
+    if (id < fixedSize.size()) {
+        return &fixedSize[id];
+    }
+    const auto& varSize = schema.varSizeFields();
+    id -= fixedSize.size();
+    return id < varSize.size() ? &varSize[id] : nullptr;
+}
+
+/**
+ * @brief Returns the id of the field with the given name
+ *
+ * @throws FieldDoesNotExist If the schema has no field with the given name
+ * @throws WrongFieldType If the field has neither the given type nor the alternative one
+ */
+inline store::Schema::id_t resolveField(const store::Schema& schema,
+        const crossbow::string& name,
+        store::FieldType type,
+        store::FieldType alternative = store::FieldType::NOTYPE) {
+    // Fields are numbered like in the record: First the fixed size ones, then the variable sized ones
+    store::Schema::id_t id = 0;
+    for (const auto* fields : {&schema.fixedSizeFields(), &schema.varSizeFields()}) {
+        for (const auto& field : *fields) {
+            if (field.name() == name) {
+                if (field.type() != type && (alternative == store::FieldType::NOTYPE || field.type() != alternative)) {
+                    throw WrongFieldType(name);
+                }
+                return id;
+            }
+            ++id;
+        }
+    }
+    throw FieldDoesNotExist(name);
+}
+
+} // namespace impl
+
+/**
+ * @brief Typed reference to a field of a schema
+ *
+ * The name of the field is looked up and its type checked once when the handle is created. Afterwards the handle
+ * gives direct access to the field of any tuple with the same schema (see Tuple::get and Tuple::set), so it can be
+ * created once and kept for the lifetime of the process, for example in a static variable:
+ *
+ * @code
+ * static FieldHandle<int32_t> nextOrderId(transaction.getSchema(district), "d_next_o_id");
+ * auto id = tuple.get(nextOrderId);
+ * @endcode
+ */
+template<class T>
+class FieldHandle {
+public: // types
+    using id_t = store::Schema::id_t;
+    using value_type = T;
+private: // members
+    id_t mId;
+    /// Schema the handle was resolved against, tables opened by other threads have a copy of it
+    const store::Schema* mSchema;
+    crossbow::string mName;
+    store::FieldType mType;
+public:
+    /**
+     * @brief Resolves the field with the given name
+     *
+     * @throws FieldDoesNotExist If the schema has no field with the given name
+     * @throws WrongFieldType If the field's type is not the one of T
+     */
+    FieldHandle(const store::Schema& schema, const crossbow::string& name)
+        : mId(impl::resolveField(schema, name, FieldTypeOf<T>::value, impl::AlternativeFieldType<T>::value))
+        , mSchema(&schema)
+        , mName(name)
+        , mType(impl::fieldOf(schema, mId)->type())
+    {}
+
+    id_t id() const {
+        return mId;
+    }
+
+    /**
+     * @brief Whether the handle can be used with tuples of the given schema
+     *
+     * Either the schema is the one the handle was resolved against or it has the same field with the same id.
+     */
+    bool belongsTo(const store::Schema& schema) const {
+        if (&schema == mSchema) {
+            return true;
+        }
+        auto field = impl::fieldOf(schema, mId);
+        return field && field->type() == mType && field->name() == mName;
+    }
+};
+
+} // namespace db
+} // namespace tell
@@ -0,0 +1,216 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include <tellstore/StdTypes.hpp>
+
+#include <crossbow/string.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+namespace tell {
+namespace db {
+namespace impl {
+
+/**
+ * @brief Tag byte preceding every field of an encoded index key
+ *
+ * NULL sorts before any value.
+ */
+enum class KeyTag : uint8_t {
+    Null = 0x00,
+    SmallInt = 0x10,
+    Int = 0x11,
+    BigInt = 0x12,
+    Float = 0x13,
+    Double = 0x14,
+    Text = 0x15
+};
+
+template<class Unsigned>
+void appendKeyBigEndian(Unsigned value, crossbow::string& key) {
+    char buffer[sizeof(Unsigned)];
+    for (size_t i = 0; i < sizeof(Unsigned); ++i) {
+        buffer[i] = static_cast<char>(value >> (8 * (sizeof(Unsigned) - 1 - i)));
+    }
+    key.append(buffer, sizeof(Unsigned));
+}
+
+/**
+ * @brief Appends an integer in big endian with the sign bit flipped
+ */
+template<class Signed>
+void appendKeyInteger(KeyTag tag, Signed value, crossbow::string& key) {
+    using Unsigned = typename std::make_unsigned<Signed>::type;
+    constexpr Unsigned signBit = Unsigned(1) << (sizeof(Unsigned) * 8 - 1);
+    key.push_back(static_cast<char>(tag));
+    appendKeyBigEndian<Unsigned>(static_cast<Unsigned>(value) ^ signBit, key);
+}
+
+/**
+ * @brief Appends the bit pattern of a floating point number
+ *
+ * Negative numbers have all bits flipped, positive ones only the sign bit. -0.0 is stored as +0.0, as both compare
+ * equal.
+ */
+template<class Float, class Unsigned>
+void appendKeyFloat(KeyTag tag, Float value, crossbow::string& key) {
+    static_assert(sizeof(Float) == sizeof(Unsigned), "Size mismatch");
+    constexpr Unsigned signBit = Unsigned(1) << (sizeof(Unsigned) * 8 - 1);
+    if (value == Float(0)) {
+        value = Float(0);
+    }
+    Unsigned bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    bits = (bits & signBit) ? ~bits : (bits | signBit);
+    key.push_back(static_cast<char>(tag));
+    appendKeyBigEndian<Unsigned>(bits, key);
+}
+
+/**
+ * @brief Appends a string with 0x00 escaped as 0x00 0xFF and terminated by 0x00 0x01
+ */
+void appendKeyString(const crossbow::string& value, crossbow::string& key);
+
+} // namespace impl
+
+/**
+ * @brief Statically typed key for index lookups
+ *
+ * Builds the binary representation of an index key directly from the values without going through a list of
+ * dynamically typed fields. The key can be passed to Transaction::lower_bound and
+ * Transaction::reverse_lower_bound, which check the types of the key against the types of the indexed columns. A key
+ * may contain fewer values than the index has columns, in which case it is a prefix of the index key.
+ *
+ * Example for an index over an INT and a BIGINT column:
+ *
+ * @code
+ * auto iter = tx.lower_bound(table, "idx", IndexKey::of(int32_t(1), int64_t(42)));
+ * @endcode
+ */
+class IndexKey {
+public: // constants
+    /**
+     * @brief Maximum number of values in a key
+     */
+    static constexpr size_t MAX_FIELDS = 16;
+private: // members
+    crossbow::string mData;
+    uint64_t mTypes = 0;
+    uint8_t mSize = 0;
+public:
+    IndexKey() = default;
+
+    template<class... Values>
+    static IndexKey of(const Values&... values) {
+        IndexKey res;
+        res.appendAll(values...);
+        return res;
+    }
+
+    IndexKey& append(int16_t value) {
+        addType(store::FieldType::SMALLINT);
+        impl::appendKeyInteger(impl::KeyTag::SmallInt, value, mData);
+        return *this;
+    }
+
+    IndexKey& append(int32_t value) {
+        addType(store::FieldType::INT);
+        impl::appendKeyInteger(impl::KeyTag::Int, value, mData);
+        return *this;
+    }
+
+    IndexKey& append(int64_t value) {
+        addType(store::FieldType::BIGINT);
+        impl::appendKeyInteger(impl::KeyTag::BigInt, value, mData);
+        return *this;
+    }
+
+    IndexKey& append(float value) {
+        addType(store::FieldType::FLOAT);
+        impl::appendKeyFloat<float, uint32_t>(impl::KeyTag::Float, value, mData);
+        return *this;
+    }
+
+    IndexKey& append(double value) {
+        addType(store::FieldType::DOUBLE);
+        impl::appendKeyFloat<double, uint64_t>(impl::KeyTag::Double, value, mData);
+        return *this;
+    }
+
+    IndexKey& append(const crossbow::string& value) {
+        addType(store::FieldType::TEXT);
+        mData.push_back(static_cast<char>(impl::KeyTag::Text));
+        impl::appendKeyString(value, mData);
+        return *this;
+    }
+
+    IndexKey& append(std::nullptr_t) {
+        addType(store::FieldType::NULLTYPE);
+        mData.push_back(static_cast<char>(impl::KeyTag::Null));
+        return *this;
+    }
+
+    /**
+     * @brief Number of values in the key
+     */
+    size_t size() const {
+        return mSize;
+    }
+
+    /**
+     * @brief Type of the value at the given position
+     */
+    store::FieldType type(size_t idx) const {
+        return static_cast<store::FieldType>((mTypes >> (4 * idx)) & 0xFu);
+    }
+
+    /**
+     * @brief The encoded key
+     */
+    const crossbow::string& data() const {
+        return mData;
+    }
+
+private:
+    void appendAll() {}
+
+    template<class Head, class... Tail>
+    void appendAll(const Head& head, const Tail&... tail) {
+        append(head);
+        appendAll(tail...);
+    }
+
+    void addType(store::FieldType type) {
+        if (mSize == MAX_FIELDS) {
+            throw std::length_error("Too many values in index key");
+        }
+        mTypes |= (static_cast<uint64_t>(type) & 0xFu) << (4 * mSize);
+        ++mSize;
+    }
+};
+
+} // namespace db
+} // namespace tell
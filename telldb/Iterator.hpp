@@ -23,6 +23,10 @@
 #pragma once
 #include "Types.hpp"
 #include "Field.hpp"
+#include "IndexKey.hpp"
+
+#include <memory>
+#include <vector>
 
 namespace tell {
 namespace db {
@@ -60,6 +64,33 @@ public:
      * @req !done()
      */
     void next();
+    /**
+     * @brief Moves the iterator to the given key
+     *
+     * Positions a forward iterator on the first entry not smaller than
+     * the key and a backward iterator on the last entry not greater
+     * than the key. If the key lies shortly after the current position
+     * the iterator steps there instead of descending the index again.
+     * The limit of a bounded iterator keeps counting across seeks.
+     */
+    void seek(const KeyType& key);
+    /**
+     * @brief Moves the iterator to the given typed key
+     *
+     * The types of the key are not checked against the index.
+     */
+    void seek(const IndexKey& key);
+    /**
+     * @brief Looks up all entries for a list of keys (IN-list)
+     *
+     * Seeks to every key in turn and collects the values of all entries
+     * starting with it. The keys should be sorted in iteration order, so
+     * the iterator only has to move forward and can reuse its position.
+     *
+     * @return Pairs of the position of the key in keys and the value
+     *         of a matching entry
+     */
+    std::vector<std::pair<size_t, ValueType>> multiSeek(const std::vector<KeyType>& keys);
     /**
      * @brief Key of the current position
      *
@@ -0,0 +1,102 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+
+namespace tell {
+namespace db {
+
+/**
+ * @brief Decides whether and when a failed transaction is run again
+ *
+ * A transaction whose function throws one of the selected exceptions is rolled back and run again in the same fiber
+ * with a fresh snapshot. Before every retry the fiber yields for a random time between zero and an exponentially
+ * growing bound.
+ *
+ * The backoff is a busy wait: Fibers have no timer to sleep on, so the fiber keeps yielding until the time passed.
+ * Other fibers of the thread run in between, but a thread with nothing else to do spins for the whole backoff. Keep
+ * maxBackoff in the range of a few network round trips.
+ */
+struct RetryPolicy {
+    /// Exception types a transaction can be retried on
+    enum Retry : uint8_t {
+        CONFLICT = 0x1u,
+        CONFLICTS = 0x2u,
+        INDEX_CONFLICT = 0x4u,
+        ALL_CONFLICTS = CONFLICT | CONFLICTS | INDEX_CONFLICT,
+    };
+
+    /// Maximum number of runs of the transaction (1 disables retries)
+    size_t maxAttempts = 1;
+    /// Bound of the backoff before the first retry
+    std::chrono::microseconds initialBackoff = std::chrono::microseconds(10);
+    /// Upper limit of the backoff bound (the backoff busy waits, see above)
+    std::chrono::microseconds maxBackoff = std::chrono::microseconds(10000);
+    /// Bitmask of Retry values selecting the exceptions to retry on
+    uint8_t retryOn = ALL_CONFLICTS;
+    /// Whether a retry starts with the tuples read by the failed attempt (validated against the new snapshot)
+    bool reuseReads = false;
+
+    /**
+     * @brief Creates a policy retrying on all conflicts up to the given number of runs
+     */
+    static RetryPolicy onConflicts(size_t maxAttempts) {
+        RetryPolicy policy;
+        policy.maxAttempts = maxAttempts;
+        return policy;
+    }
+
+    /**
+     * @brief Whether the exception is a write-write conflict of any kind
+     */
+    static bool isConflict(const std::exception& e);
+
+    /**
+     * @brief Whether the transaction should run again after the given failed attempt (starting at 1)
+     */
+    bool shouldRetry(const std::exception& e, size_t attempt) const;
+
+    /**
+     * @brief Randomized time to wait before the retry following the given failed attempt
+     */
+    std::chrono::microseconds backoff(size_t attempt) const;
+};
+
+/**
+ * @brief Counters of the transaction runs
+ */
+struct RetryStats {
+    /// Number of times a transaction function was run
+    uint64_t attempts = 0;
+    /// Number of runs aborted by a conflict
+    uint64_t conflicts = 0;
+    /// Number of runs started again by the retry policy
+    uint64_t retries = 0;
+};
+
+} // namespace db
+} // namespace tell
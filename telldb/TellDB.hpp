@@ -22,6 +22,8 @@
  */
 #pragma once
 #include <type_traits>
+#include <atomic>
+#include <chrono>
 #include <memory>
 
 #include <crossbow/singleton.hpp>
@@ -30,6 +32,7 @@
 #include <tellstore/TransactionRunner.hpp>
 
 #include "Transaction.hpp"
+#include "RetryPolicy.hpp"
 
 namespace tell {
 namespace db {
@@ -40,6 +43,48 @@ template<class Context>
 class ClientManager;
 
 class CounterImpl;
+class BdTreeNodeCache;
+
+/**
+ * @brief Settings for sharing one undo log record between transactions of the same thread
+ *
+ * With group commit enabled, transactions of a thread that write their undo log at the same time
+ * combine their logs into one record written with a single request.
+ */
+struct GroupCommitConfig {
+    /// Whether transactions share undo log records
+    bool enabled = false;
+    /// Maximum time the first transaction of a group waits for others to join
+    std::chrono::microseconds window = std::chrono::microseconds(50);
+    /// Maximum number of transactions sharing one record
+    size_t maxTransactions = 32;
+    /// Maximum size of a shared record in bytes, larger undo logs are written on their own
+    size_t maxBytes = 64 * 1024;
+};
+
+/**
+ * @brief Counters of the undo log group commit
+ */
+struct GroupCommitStats {
+    /// Number of shared records written
+    uint64_t groups = 0;
+    /// Number of transactions whose undo log was part of a shared record
+    uint64_t transactions = 0;
+    /// Number of bytes written in shared records
+    uint64_t bytes = 0;
+};
+
+/**
+ * @brief Counters of the Bd-Tree page cache shared by all threads
+ */
+struct NodeCacheStats {
+    /// Number of page reads answered by the cache
+    uint64_t hits = 0;
+    /// Number of page reads that had to go to the storage
+    uint64_t misses = 0;
+    /// Number of pages evicted to stay within the capacity
+    uint64_t evictions = 0;
+};
 
 namespace impl {
 
@@ -48,9 +93,18 @@ class ClientTable {
     ClientTable() {}
     void init(store::ClientHandle& handle);
     void destroy(store::ClientHandle& handle);
+    void setNodeCacheCapacity(size_t capacity);
     uint64_t mClientId = 0;
     std::unique_ptr<store::Table> mClientsTable = nullptr;
     std::unique_ptr<store::Table> mTransactionsTable = nullptr;
+    std::shared_ptr<BdTreeNodeCache> mNodeCache = nullptr;
+    GroupCommitConfig mGroupCommitConfig;
+    std::atomic<uint64_t> mGroups{0};
+    std::atomic<uint64_t> mGroupedTransactions{0};
+    std::atomic<uint64_t> mGroupedBytes{0};
+    std::atomic<uint64_t> mAttempts{0};
+    std::atomic<uint64_t> mConflicts{0};
+    std::atomic<uint64_t> mRetries{0};
 public:
     /**
      * @brief Table where clients register themselves
@@ -62,19 +116,100 @@ public:
     const store::Table& txTable() const {
         return *mTransactionsTable;
     }
+
+    /**
+     * @brief Cache of Bd-Tree pages shared by all threads of the client
+     */
+    BdTreeNodeCache& nodeCache() const {
+        return *mNodeCache;
+    }
+
+    const GroupCommitConfig& groupCommitConfig() const {
+        return mGroupCommitConfig;
+    }
+
+    /**
+     * @brief Accounts a shared undo log record of the given number of transactions and bytes
+     */
+    void recordGroupCommit(size_t transactions, size_t bytes) {
+        mGroups.fetch_add(1, std::memory_order_relaxed);
+        mGroupedTransactions.fetch_add(transactions, std::memory_order_relaxed);
+        mGroupedBytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Accounts a run of a transaction function
+     */
+    void recordAttempt(bool conflict, bool retry) {
+        mAttempts.fetch_add(1, std::memory_order_relaxed);
+        if (conflict) {
+            mConflicts.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (retry) {
+            mRetries.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    RetryStats retryStats() const {
+        RetryStats stats;
+        stats.attempts = mAttempts.load(std::memory_order_relaxed);
+        stats.conflicts = mConflicts.load(std::memory_order_relaxed);
+        stats.retries = mRetries.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    GroupCommitStats groupCommitStats() const {
+        GroupCommitStats stats;
+        stats.groups = mGroups.load(std::memory_order_relaxed);
+        stats.transactions = mGroupedTransactions.load(std::memory_order_relaxed);
+        stats.bytes = mGroupedBytes.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+    NodeCacheStats nodeCacheStats() const;
 };
 
 class Indexes;
-Indexes* createIndexes(store::ClientHandle& handle);
+class UndoLogJanitor;
+class CacheSizeHistory;
+struct UndoLogGroup;
+Indexes* createIndexes(store::ClientHandle& handle, ClientTable& clientTable);
 struct TellDBContext {
     TellDBContext(ClientTable* table);
     ~TellDBContext();
     void setIndexes(Indexes* idxs);
+    /**
+     * @brief Opens the table with the given name, only asks the storage if it was not opened on this thread before
+     */
+    Future<table_t> openTable(store::ClientHandle& handle, const crossbow::string& name);
+    /**
+     * @brief Creates a new table (without its indexes) and registers it
+     */
+    const store::Table& createTable(store::ClientHandle& handle,
+            const crossbow::string& name,
+            const store::Schema& schema);
+    /**
+     * @brief Registers a table received from the storage and returns its id
+     */
+    table_t addTable(store::Table table);
+    const store::Record& record(table_t table) const;
+    /**
+     * @brief Removes the undo logs of the finished transactions of this thread and waits for the removals
+     *
+     * Has to run in a fiber of this thread before the context gets destroyed.
+     */
+    void flushUndoLogs(store::ClientHandle& handle);
     std::unordered_map<table_t, tell::store::Table*> tables;
     std::unordered_map<crossbow::string, CounterImpl*> counters;
     std::unordered_map<crossbow::string, table_t> tableNames;
     std::unique_ptr<Indexes> indexes;
     ClientTable* clientTable;
+    /// Removes the undo logs of the transactions finished on this thread
+    std::unique_ptr<UndoLogJanitor> logJanitor;
+    /// Shared undo log record transactions of this thread can still join
+    std::shared_ptr<UndoLogGroup> openLogGroup;
+    /// Sizes of the caches recent transactions of this thread needed
+    std::unique_ptr<CacheSizeHistory> cacheSizes;
 };
 
 template<class Context>
@@ -127,40 +262,75 @@ private: // construction
     {}
 private: // private access
     template<class Fun>
-    void exec(Fun fun, int cpu) {
+    void exec(Fun fun, int cpu, const RetryPolicy& policy) {
         auto type = mTxType;
+        auto run = [type, fun, policy](tell::store::ClientHandle& handle, telldb_context& context) {
+            runTransaction(fun, handle, context, type, policy);
+        };
         if (cpu < 0)
-            mTxRunner->execute([type, fun](tell::store::ClientHandle& handle, telldb_context& context) {
-                if (context.mContext.indexes == nullptr) {
-                    context.mContext.setIndexes(impl::createIndexes(handle));
-                }
-                try {
-                    auto snapshot = handle.startTransaction(type);
-                    Transaction transaction(handle, context.mContext, std::move(snapshot), type);
-                    context.executeHandler(fun, transaction);
-                } catch (std::exception& e) {
-                    std::cerr << "Exception: " << e.what() << std::endl;
-                } catch (...) {
-                    // This should never happen
-                    std::cerr << "Got an unknown error" << std::endl;
+            mTxRunner->execute(std::move(run));
+        else
+            mTxRunner->execute(cpu, std::move(run));
+    }
+
+    /**
+     * @brief Runs the transaction function until it succeeds or the policy gives up
+     *
+     * Every attempt runs in a new transaction with a fresh snapshot, the previous one is rolled back before the
+     * backoff.
+     */
+    template<class Fun>
+    static void runTransaction(Fun& fun,
+            tell::store::ClientHandle& handle,
+            telldb_context& context,
+            tell::store::TransactionType type,
+            const RetryPolicy& policy) {
+        if (context.mContext.indexes == nullptr) {
+            context.mContext.setIndexes(impl::createIndexes(handle, *context.mContext.clientTable));
+        }
+        auto& clientTable = *context.mContext.clientTable;
+        // Finished attempt whose reads are handed to the next one
+        std::unique_ptr<Transaction> previous;
+        for (size_t attempt = 1;; ++attempt) {
+            std::chrono::microseconds backoff(0);
+            std::unique_ptr<Transaction> transaction;
+            try {
+                auto snapshot = handle.startTransaction(type);
+                transaction.reset(new Transaction(handle, context.mContext, std::move(snapshot), type));
+                if (previous) {
+                    transaction->carryReads(*previous);
+                    previous.reset();
                 }
-            });
-        else 
-            mTxRunner->execute(cpu, [type, fun](tell::store::ClientHandle& handle, telldb_context& context) {
-                if (context.mContext.indexes == nullptr) {
-                    context.mContext.setIndexes(impl::createIndexes(handle));
+                context.executeHandler(fun, *transaction);
+                transaction.reset();
+                clientTable.recordAttempt(false, false);
+                return;
+            } catch (std::exception& e) {
+                auto retry = policy.shouldRetry(e, attempt);
+                clientTable.recordAttempt(RetryPolicy::isConflict(e), retry);
+                if (retry && policy.reuseReads && transaction) {
+                    transaction->finish();
+                    previous = std::move(transaction);
                 }
-                try {
-                    auto snapshot = handle.startTransaction(type);
-                    Transaction transaction(handle, context.mContext, std::move(snapshot), type);
-                    context.executeHandler(fun, transaction);
-                } catch (std::exception& e) {
+                // Roll back before backing off
+                transaction.reset();
+                if (!retry) {
                     std::cerr << "Exception: " << e.what() << std::endl;
-                } catch (...) {
-                    // This should never happen
-                    std::cerr << "Got an unknown error" << std::endl;
+                    return;
                 }
-            });
+                backoff = policy.backoff(attempt);
+            } catch (...) {
+                // This should never happen
+                clientTable.recordAttempt(false, false);
+                std::cerr << "Got an unknown error" << std::endl;
+                return;
+            }
+            // Yield instead of sleeping, other fibers of the thread keep running (a busy wait, see RetryPolicy)
+            auto until = std::chrono::steady_clock::now() + backoff;
+            while (std::chrono::steady_clock::now() < until) {
+                handle.fiber().yield();
+            }
+        }
     }
 public: // construction
     TransactionFiber(const TransactionFiber&) = delete;
@@ -217,6 +387,7 @@ template<class Context>
 class ClientManager {
 private:
     tell::store::ClientManager<impl::FiberContext<Context>> mClientManager;
+    int mNumThreads;
     impl::ClientTable mClientTable;
     std::unique_ptr<store::ScanMemoryManager> mScanMemoryManager;
 public:
@@ -239,6 +410,7 @@ public:
     template<class... Args>
     ClientManager(tell::store::ClientConfig& clientConfig, Args... args)
         : mClientManager(clientConfig, &mClientTable, args...)
+        , mNumThreads(clientConfig.numNetworkThreads)
     {
         store::TransactionRunner::executeBlocking(mClientManager,
                 [this](store::ClientHandle &handle, impl::FiberContext<Context>&){
@@ -247,6 +419,14 @@ public:
     }
 
     ~ClientManager() {
+        // The contexts can not send anything themselves, the undo logs still queued are removed beforehand
+        for (int cpu = 0; cpu < mNumThreads; ++cpu) {
+            store::SingleTransactionRunner<impl::FiberContext<Context>> runner(mClientManager);
+            runner.execute(cpu, [](store::ClientHandle& handle, impl::FiberContext<Context>& context) {
+                context.mContext.flushUndoLogs(handle);
+            });
+            runner.wait();
+        }
         store::TransactionRunner::executeBlocking(mClientManager,
                 [this](store::ClientHandle &handle, impl::FiberContext<Context>&){
             mClientTable.destroy(handle);
@@ -278,12 +458,73 @@ public:
             Fun&& fun,
             tell::store::TransactionType type = tell::store::TransactionType::READ_WRITE,
             int cpu = -1)
+    {
+        return startTransaction(std::forward<Fun>(fun), RetryPolicy(), type, cpu);
+    }
+
+    /**
+     * @brief starts a new transaction and executes fun within its context, retrying it on failure
+     *
+     * Like startTransaction above, but if fun throws an exception selected by the policy the
+     * transaction gets rolled back and fun runs again in the same fiber with a new snapshot.
+     * fun therefore has to be safe to call more than once.
+     *
+     * @param[in] fun The function to call, see above
+     * @param[in] policy Decides which failures are retried and how long to back off
+     * @param[in] type The type of the transaction
+     * @param[in] cpu Put fiber on thread cpu
+     */
+    template<class Fun>
+    TransactionFiber<Context> startTransaction(
+            Fun&& fun,
+            const RetryPolicy& policy,
+            tell::store::TransactionType type = tell::store::TransactionType::READ_WRITE,
+            int cpu = -1)
     {
         TransactionFiber<Context> fiber(mClientManager, type);
-        fiber.exec(std::forward<Fun>(fun), cpu);
+        fiber.exec(std::forward<Fun>(fun), cpu, policy);
         return fiber;
     }
 
+    /**
+     * @brief Returns the counters of the transaction runs of all threads
+     */
+    RetryStats retryStats() const {
+        return mClientTable.retryStats();
+    }
+
+    /**
+     * @brief Configures the undo log group commit
+     *
+     * Must be called before any transaction is started.
+     */
+    void setGroupCommitConfig(const GroupCommitConfig& config) {
+        mClientTable.mGroupCommitConfig = config;
+    }
+
+    /**
+     * @brief Returns the counters of the undo log group commit
+     */
+    GroupCommitStats groupCommitStats() const {
+        return mClientTable.groupCommitStats();
+    }
+
+    /**
+     * @brief Sets the size in bytes of the Bd-Tree page cache shared by all threads
+     *
+     * Defaults to 64 MB. When shrinking the cache, pages are evicted as new pages are cached.
+     */
+    void setNodeCacheCapacity(size_t capacity) {
+        mClientTable.setNodeCacheCapacity(capacity);
+    }
+
+    /**
+     * @brief Returns the counters of the Bd-Tree page cache
+     */
+    NodeCacheStats nodeCacheStats() const {
+        return mClientTable.nodeCacheStats();
+    }
+
     /**
      * @brief allocates scan memomry. Be cautious with this call as it is extremely expensive!
      *
@@ -22,12 +22,16 @@
  */
 #pragma once
 #include "Tuple.hpp"
+#include "TupleMapping.hpp"
 #include "Types.hpp"
 #include "Iterator.hpp"
+#include "IndexKey.hpp"
 
 #include <tellstore/TransactionType.hpp>
 #include <tellstore/ClientSocket.hpp>
 #include <crossbow/ChunkAllocator.hpp>
+#include <deque>
+#include <limits>
 #include <tuple>
 
 /**
@@ -50,6 +54,7 @@ namespace store {
 class ClientHandle;
 class GetTableResponse;
 class GetResponse;
+class ModificationResponse;
 
 } // namespace store
 
@@ -57,8 +62,12 @@ namespace db {
 
 namespace impl {
 struct TellDBContext;
+struct UndoLogGroup;
+struct EagerWriteState;
+class UndoLogWriter;
 } // namespace impl
 class TransactionCache;
+class ReadOnlyCache;
 
 #ifdef DOXYGEN
 
@@ -122,12 +131,12 @@ class Future;
 
 template<>
 class Future<table_t> {
-    friend class TransactionCache;
+    friend struct impl::TellDBContext;
     std::shared_ptr<tell::store::GetTableResponse> resp;
-    TransactionCache& cache;
+    impl::TellDBContext& context;
     crossbow::string name;
     table_t result;
-    Future(std::shared_ptr<tell::store::GetTableResponse>&& resp, TransactionCache& cache);
+    Future(std::shared_ptr<tell::store::GetTableResponse>&& resp, impl::TellDBContext& context);
 public:
     bool done() const;
     bool wait() const;
@@ -135,15 +144,18 @@ public:
 };
 
 class TableCache;
+class ReadOnlyTableCache;
+class TupleCache;
 template<>
 class Future<Tuple> {
     friend class TableCache;
+    friend class ReadOnlyTableCache;
     key_t key;
     const Tuple* result;
-    TableCache* cache;
+    TupleCache* cache;
     std::shared_ptr<tell::store::GetResponse> response;
     Future(key_t key, const Tuple* result);
-    Future(key_t key, TableCache* cache, std::shared_ptr<tell::store::GetResponse>&& response);
+    Future(key_t key, TupleCache* cache, std::shared_ptr<tell::store::GetResponse>&& response);
 public:
     bool done() const;
     bool wait() const;
@@ -168,23 +180,67 @@ public:
 };
 
 class ScanQuery;
+class IndexScan;
+
+template<class Context>
+class TransactionFiber;
 
 class Transaction {
+    template<class Context> friend class TransactionFiber;
 public: // Types
     /**
      *  A string which has a life time equal to the lifetime of the transaction
      */ 
     using ChunkString = crossbow::basic_string<char, std::char_traits<char>, crossbow::ChunkAllocator<char>>;
+    /**
+     * A list of tuples which has a life time equal to the lifetime of the transaction
+     */
+    using TupleList = std::vector<const Tuple*, crossbow::ChunkAllocator<const Tuple*>>;
+    /**
+     * List of tuple keys of several tables
+     */
+    using KeyList = std::vector<std::pair<table_t, key_t>, crossbow::ChunkAllocator<std::pair<table_t, key_t>>>;
+public: // constants
+    /**
+     * Default number of tuples an index scan requests ahead of time
+     */
+    static constexpr size_t DEFAULT_INDEX_PREFETCH = 16;
+private: // types
+    using ResponseList = std::vector<std::shared_ptr<store::ModificationResponse>,
+            crossbow::ChunkAllocator<std::shared_ptr<store::ModificationResponse>>>;
 private:
     tell::store::ClientHandle& mHandle;
     impl::TellDBContext& mContext;
     crossbow::ChunkMemoryPool mPool;
     std::unique_ptr<commitmanager::SnapshotDescriptor> mSnapshot;
+    // only read-write transactions have a transaction cache
     std::unique_ptr<TransactionCache> mCache;
+    // reads of read-only and analytical transactions bypass the transaction cache
+    std::unique_ptr<ReadOnlyCache> mReadCache;
     // will be set to true if there is any data
     // written to the storage
     store::TransactionType mType;
     bool mCommitted = false;
+    // number of undo log tuples written to the storage
+    uint64_t mUndoLogChunks = 0;
+    // number of modifications after which the changes get flushed (0 to only write on commit)
+    size_t mFlushThreshold = 0;
+    // number of modifications since the last flush
+    size_t mUnflushed = 0;
+    // size of the modified tuples after which the changes get flushed (0 to ignore the size)
+    size_t mFlushBytes = 0;
+    // size of the tuples modified since the last flush
+    size_t mUnflushedBytes = 0;
+    // shared undo log record if the log was written as part of a group
+    std::shared_ptr<impl::UndoLogGroup> mUndoLogGroup;
+    // whether modifications are sent to the storage right away
+    bool mEagerWrites = false;
+    // number of modified keys sharing one eager undo log segment
+    size_t mEagerBatchKeys = 1;
+    // size of the modified tuples after which an eager undo log segment is sent before the batch is full
+    size_t mEagerBatchBytes = 64*1024;
+    // queued keys and undo log segments of the eager writes, created when they get enabled
+    std::unique_ptr<impl::EagerWriteState> mEager;
 public:
     Transaction(tell::store::ClientHandle& handle,
             impl::TellDBContext& context,
@@ -245,8 +301,98 @@ public: // read-write operations
      * @return A future holding the result
      */
     Future<Tuple> get(table_t tableId, key_t key);
+    /**
+     * @brief Gets several tuples of a table at once
+     *
+     * All keys are first looked up in the local cache, the remaining
+     * ones are requested from the storage together before waiting for
+     * any of the responses. This function blocks until all tuples are
+     * available.
+     *
+     * @param table The table id
+     * @param keys  The keys of the tuples
+     * @return A list with one entry per key, in the order of the keys.
+     *         An entry is nullptr if the tuple does not exist or was
+     *         deleted by this transaction.
+     */
+    TupleList multiGet(table_t tableId, const std::vector<key_t>& keys);
     Iterator lower_bound(table_t tableId, const crossbow::string& idxName, const KeyType& key);
     Iterator reverse_lower_bound(table_t tableId, const crossbow::string& idxName, const KeyType& key);
+    /**
+     * @brief Looks up a statically typed key in an index
+     *
+     * Behaves like the KeyType overload but does not build a list of Fields for the key. The types of the key have to
+     * match the types of the indexed columns, otherwise WrongFieldType is thrown.
+     */
+    Iterator lower_bound(table_t tableId, const crossbow::string& idxName, const IndexKey& key);
+    Iterator reverse_lower_bound(table_t tableId, const crossbow::string& idxName, const IndexKey& key);
+    /**
+     * @brief Iterates over a bounded index range
+     *
+     * Starts at the first entry not smaller than from and stops before
+     * the first entry greater than to (inclusive) or not smaller than
+     * to (exclusive). If to has fewer fields than the index, an
+     * inclusive range contains all entries starting with to and an
+     * exclusive one none of them. The iterator stops after limit
+     * entries. No index pages beyond the range are read.
+     *
+     * @param table     The table id
+     * @param idxName   The name of the index
+     * @param from      The first key of the range
+     * @param to        The last key of the range
+     * @param inclusive Whether entries equal to to are part of the range
+     * @param limit     Maximum number of entries
+     */
+    Iterator range(table_t tableId,
+            const crossbow::string& idxName,
+            const KeyType& from,
+            const KeyType& to,
+            bool inclusive = true,
+            size_t limit = std::numeric_limits<size_t>::max());
+    /**
+     * @brief Iterates backwards over a bounded index range
+     *
+     * Like range, but starts at the last entry not greater than from
+     * and stops at the lower bound to.
+     */
+    Iterator reverse_range(table_t tableId,
+            const crossbow::string& idxName,
+            const KeyType& from,
+            const KeyType& to,
+            bool inclusive = true,
+            size_t limit = std::numeric_limits<size_t>::max());
+    /**
+     * @brief Scans an index and returns the referenced tuples
+     *
+     * Starts at the first index entry not smaller than from. The
+     * tuples of the next entries are requested from the storage
+     * ahead of time, so the caller can process one tuple while the
+     * following ones are being fetched.
+     *
+     * @param table    The table id
+     * @param idxName  The name of the index
+     * @param from     The first key of the range
+     * @param limit    Maximum number of tuples to return
+     * @param prefetch Number of tuples requested ahead of time
+     */
+    IndexScan indexScan(table_t tableId,
+            const crossbow::string& idxName,
+            const KeyType& from,
+            size_t limit = std::numeric_limits<size_t>::max(),
+            size_t prefetch = DEFAULT_INDEX_PREFETCH);
+    /**
+     * @brief Scans an index range and returns the referenced tuples
+     *
+     * Like the other overload, but stops at the last index entry
+     * smaller than (or if inclusive is set equal to) to.
+     */
+    IndexScan indexScan(table_t tableId,
+            const crossbow::string& idxName,
+            const KeyType& from,
+            const KeyType& to,
+            bool inclusive,
+            size_t limit = std::numeric_limits<size_t>::max(),
+            size_t prefetch = DEFAULT_INDEX_PREFETCH);
     /**
      * @brief Create a new empty tuple
      */
@@ -283,6 +429,20 @@ public: // read-write operations
      * @throws FieldNotSet If a required field is not set in the tuple.
      */
     void insert(table_t table, key_t key, const std::unordered_map<crossbow::string, Field>& values);
+    /**
+     * @brief Inserts a mapped struct
+     *
+     * The struct is serialized into the record format once, no Fields are built for its members.
+     *
+     * @param table  The table id
+     * @param key    The key of the tuple
+     * @param mapper The mapper of the struct, resolved against the schema of the table
+     * @param value  The value to insert
+     */
+    template<class S>
+    void insert(table_t table, key_t key, const TupleMapper<S>& mapper, const S& value) {
+        insert(table, key, mapper.write(getRecord(table), value, mPool));
+    }
     /**
      * @brief Updates a tuple
      *
@@ -303,6 +463,15 @@ public: // read-write operations
      * @throws Conflict If a conflict is detected.
      */
     void update(table_t table, key_t key, const Tuple& from, const Tuple& to);
+    /**
+     * @brief Updates a tuple to the value of a mapped struct
+     *
+     * Like the insert of a mapped struct, the new version is serialized once without building Fields.
+     */
+    template<class S>
+    void update(table_t table, key_t key, const Tuple& from, const TupleMapper<S>& mapper, const S& to) {
+        update(table, key, from, mapper.write(getRecord(table), to, mPool));
+    }
     /**
      * @brief Deletes a tuple
      *
@@ -348,10 +517,112 @@ public: // finish
      * @throws Conflict if a conflict gets detected.
      */
     void commit();
+    /**
+     * @brief Writes the changes made so far to the storage before the commit
+     *
+     * The changes and index updates not yet written are sent to the storage
+     * together with a new segment of the undo log. The transaction stays
+     * open and can continue to modify tuples, including the ones written.
+     * Tuples returned by get stay valid.
+     *
+     * @throws Conflicts If a change conflicted, the transaction has to be rolled back.
+     */
+    void flush();
+    /**
+     * @brief Flushes the changes every flushThreshold modifications
+     *
+     * Meant for bulk transactions too large to keep all changes until the
+     * commit: Instead of sending the whole change set at once, it is written
+     * incrementally while the transaction runs. Write-write conflicts are then
+     * reported by the modification triggering the flush.
+     *
+     * @param flushThreshold Number of modifications between two flushes, 0 only writes on commit.
+     * @param flushBytes Size of the modified tuples after which the changes get flushed as well, 0 to only count
+     *        the modifications.
+     */
+    void setFlushThreshold(size_t flushThreshold, size_t flushBytes = 0) {
+        mFlushThreshold = flushThreshold;
+        mFlushBytes = flushBytes;
+    }
+    /**
+     * @brief Sends every modification to the storage right away
+     *
+     * Instead of buffering the changes until the commit, insert, update and
+     * remove log the modified key and start the write in the background.
+     * Network time then overlaps with the application logic, the commit only
+     * waits for the outstanding writes and write-write conflicts are reported
+     * by a later modification already. Index changes are still written on
+     * commit. Tuples returned by get stay valid.
+     *
+     * By default every modified key is logged and written right away. With
+     * a larger batch, an undo log segment is only sent once batchKeys keys
+     * are queued or their tuples exceed batchBytes: Fewer segments are
+     * written, but the writes of the batch start later. Keys modified while
+     * a segment is in flight are queued until it completed. Once the undo
+     * log used up half of its chunks, the remaining modifications are only
+     * written on commit.
+     *
+     * @param eagerWrites Whether to send the modifications right away
+     * @param batchKeys Number of modified keys sharing one undo log segment
+     * @param batchBytes Size of the modified tuples after which a segment is sent before the batch is full
+     */
+    void setEagerWrites(bool eagerWrites, size_t batchKeys = 1, size_t batchBytes = 64*1024);
 private:
+    /**
+     * @brief Rolls the transaction back unless it already finished
+     */
+    void finish();
+    /**
+     * @brief Takes over the tuples read by the previous attempt of the transaction
+     *
+     * The previous attempt has to be finished.
+     */
+    void carryReads(const Transaction& previous);
     void writeBack(bool withIndexes = true);
-    void writeUndoLog(std::pair<size_t, uint8_t*> log);
-    void removeUndoLog(std::pair<size_t, uint8_t*> log);
+    /**
+     * @brief Throws if the transaction is not allowed to modify tuples
+     */
+    void checkWritable() const;
+    /**
+     * @brief Completes a read-only transaction at the commit manager
+     */
+    void finishReadOnly();
+    /**
+     * @brief Starts the eager write of the modified key and flushes the changes if the flush threshold is reached
+     */
+    void modified(table_t table, key_t key, const Tuple* tuple);
+    /**
+     * @brief Advances the eager writes without waiting
+     *
+     * Sends the changes whose undo log got written, writes the undo log of the
+     * keys modified since and collects the write responses already received.
+     *
+     * @throws Conflicts If an eager write conflicted
+     */
+    void pumpEagerWrites();
+    /**
+     * @brief Waits until all eager writes completed
+     *
+     * @throws Conflicts If an eager write conflicted
+     */
+    void drainEagerWrites();
+    void writeUndoLog(const impl::UndoLogWriter& log);
+    /**
+     * @brief Sends the undo log segments without waiting for the responses
+     */
+    void issueUndoLog(const impl::UndoLogWriter& log, ResponseList& responses);
+    /**
+     * @brief Writes the undo log as part of a record shared with other transactions of the thread
+     *
+     * @return False if the log has to be written on its own
+     */
+    bool writeGroupedUndoLog(const impl::UndoLogWriter& log);
+    /**
+     * @brief Hands the undo log over to the log janitor of the thread
+     *
+     * Must only be called after the transaction completed at the commit manager.
+     */
+    void releaseUndoLog();
     const store::Record& getRecord(table_t tableId) const;
 public: // non-commands
     /**
@@ -381,6 +652,61 @@ public: // non-commands
     }
 };
 
+/**
+ * @brief Cursor over an index range returning the referenced tuples
+ *
+ * Keeps the get requests for the next tuples of the range in flight
+ * while the caller processes the current one.
+ *
+ * @code
+ * for (auto scan = tx.indexScan(table, "idx", from, 20); !scan.done(); scan.next()) {
+ *     const Tuple& tuple = scan.tuple();
+ * }
+ * @endcode
+ */
+class IndexScan {
+    friend class Transaction;
+    Transaction& mTransaction;
+    table_t mTable;
+    Iterator mIter;
+    size_t mPrefetch;
+    std::deque<std::pair<key_t, Future<Tuple>>> mPending;
+    IndexScan(Transaction& transaction, table_t table, Iterator iter, size_t prefetch);
+public:
+    /**
+     * @brief Checks whether the scan is past its last tuple
+     */
+    bool done() const {
+        return mPending.empty();
+    }
+    /**
+     * @brief Primary key of the current tuple
+     *
+     * @req !done()
+     */
+    key_t key() const {
+        return mPending.front().first;
+    }
+    /**
+     * @brief The current tuple
+     *
+     * Blocks until the tuple was received from the storage.
+     *
+     * @req !done()
+     */
+    const Tuple& tuple() {
+        return mPending.front().second.get();
+    }
+    /**
+     * @brief Moves the scan to the next tuple
+     *
+     * @req !done()
+     */
+    void next();
+private:
+    void fill();
+};
+
 template<id_t id, class... T>
 struct tuple_set {
     static void set(const std::tuple<T...>& tuple, Tuple& t) {
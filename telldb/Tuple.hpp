@@ -22,12 +22,15 @@
  */
 #pragma once
 #include "Field.hpp"
+#include "FieldHandle.hpp"
 
 #include <tellstore/AbstractTuple.hpp>
 #include <tellstore/Record.hpp>
 #include <crossbow/ChunkAllocator.hpp>
+#include <crossbow/logger.hpp>
 
 #include <memory>
+#include <stdexcept>
 #include <unordered_map>
 
 namespace tell {
@@ -36,34 +39,58 @@ class Tuple;
 } // namespace store
 namespace db {
 
+template<class S>
+class TupleMapper;
+
+/**
+ * @brief A row of a table
+ *
+ * Tuples read from the storage keep the record they were received in and only decode a field when it is accessed for
+ * the first time. Non-const access decodes all fields: Tuples the user modifies are fully materialized. Copies share a
+ * record that lives in the memory pool (see TupleMapper) and decode the ones received from the storage.
+ */
 class Tuple : public tell::store::AbstractTuple, public crossbow::ChunkObject {
+    template<class S> friend class TupleMapper;
 public: // types
     using id_t = tell::store::Schema::id_t;
 private: // members
     const tell::store::Record& mRecord;
     crossbow::ChunkMemoryPool& mPool;
-    std::vector<Field, crossbow::ChunkAllocator<Field>> mFields;
+    mutable std::vector<Field, crossbow::ChunkAllocator<Field>> mFields;
+    /// The record as received from the storage
+    mutable std::unique_ptr<tell::store::Tuple> mData;
+    /// The serialized record, null once all fields are decoded
+    mutable const char* mRaw = nullptr;
+    /// Size of the serialized record if the tuple was built from a record in the pool, 0 otherwise
+    uint32_t mRawSize = 0;
+    /// Which fields of the record are already decoded
+    mutable std::vector<bool, crossbow::ChunkAllocator<bool>> mDecoded;
 public: // Construction
     Tuple(const tell::store::Record& record, crossbow::ChunkMemoryPool& pool);
+    /**
+     * @brief Wraps a record received from the storage without decoding it
+     */
     Tuple(const tell::store::Record& record,
-          const tell::store::Tuple& tuple,
+          std::unique_ptr<tell::store::Tuple> tuple,
           crossbow::ChunkMemoryPool& pool);
-    Tuple(const Tuple& other)
-        : mRecord(other.mRecord)
-        , mPool(other.mPool)
-        , mFields(other.mFields)
-    {}
-    Tuple(Tuple&& other)
-        : mRecord(other.mRecord)
-        , mPool(other.mPool)
-        , mFields(std::move(other.mFields))
-    {}
+    /**
+     * @brief Wraps a serialized record allocated from the memory pool without decoding it
+     */
+    Tuple(const tell::store::Record& record, const char* data, uint32_t size, crossbow::ChunkMemoryPool& pool);
+    Tuple(const Tuple& other);
+    /**
+     * @brief Copies the tuple into another memory pool
+     */
+    Tuple(const Tuple& other, crossbow::ChunkMemoryPool& pool);
+    Tuple(Tuple&& other);
+    ~Tuple();
 public: // Access
     Field& operator[] (id_t id) {
+        materialize();
         return mFields[id];
     }
     const Field& operator[] (id_t id) const {
-        return mFields[id];
+        return field(id);
     }
 
     Field& operator[] (const crossbow::string& name) {
@@ -78,11 +105,15 @@ public: // Access
     }
 
     Field& at(id_t id) {
+        materialize();
         return mFields.at(id);
     }
 
     const Field& at(id_t id) const {
-        return mFields.at(id);
+        if (id >= mFields.size()) {
+            throw std::out_of_range("Field id out of range");
+        }
+        return field(id);
     }
 
     Field& at(const crossbow::string& name) {
@@ -99,9 +130,74 @@ public: // Access
     const id_t count() const {
         return mFields.size();
     }
+public: // Typed access
+    /**
+     * @brief Reads a field without going through a Field
+     *
+     * Fields not yet decoded are read straight from the record. NULL fields read as a default constructed value, use
+     * isNull to tell them apart.
+     */
+    template<class T>
+    T get(const FieldHandle<T>& handle) const {
+        LOG_ASSERT(handle.belongsTo(mRecord.schema()), "Field handle of a different schema");
+        return get<T>(handle.id());
+    }
+
+    template<class T>
+    bool isNull(const FieldHandle<T>& handle) const {
+        LOG_ASSERT(handle.belongsTo(mRecord.schema()), "Field handle of a different schema");
+        return field(handle.id()).null();
+    }
+
+    template<class T>
+    void set(const FieldHandle<T>& handle, T value) {
+        LOG_ASSERT(handle.belongsTo(mRecord.schema()), "Field handle of a different schema");
+        (*this)[handle.id()] = Field(std::move(value));
+    }
 public:
     size_t size() const override;
     void serialize(char* dest) const override;
+private:
+    /**
+     * @brief Reads the field with the given id, its type has to be T
+     */
+    template<class T>
+    T get(id_t id) const {
+        if (mRaw && !mDecoded[id]) {
+            T result = T();
+            readField(id, result);
+            return result;
+        }
+        const Field& decoded = mFields[id];
+        return decoded.null() ? T() : decoded.value<T>();
+    }
+    const Field& field(id_t id) const {
+        if (mRaw && !mDecoded[id]) {
+            decode(id);
+        }
+        return mFields[id];
+    }
+    void decode(id_t id) const;
+    /**
+     * @brief Reads a field from the record, returns false if it is NULL
+     */
+    bool readField(id_t id, int16_t& value) const;
+    bool readField(id_t id, int32_t& value) const;
+    bool readField(id_t id, int64_t& value) const;
+    bool readField(id_t id, float& value) const;
+    bool readField(id_t id, double& value) const;
+    bool readField(id_t id, crossbow::string& value) const;
+    /**
+     * @brief Decodes all fields not yet decoded and releases the record
+     */
+    void materialize() const;
+    /**
+     * @brief Returns all fields, decoding them first if necessary
+     */
+    const std::vector<Field, crossbow::ChunkAllocator<Field>>& fields() const {
+        materialize();
+        return mFields;
+    }
 };
 
 } // namespace db
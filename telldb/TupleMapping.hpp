@@ -0,0 +1,338 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+#pragma once
+#include "Tuple.hpp"
+#include "FieldHandle.hpp"
+
+#include <tellstore/AbstractTuple.hpp>
+#include <tellstore/Record.hpp>
+#include <crossbow/alignment.hpp>
+#include <crossbow/ChunkAllocator.hpp>
+#include <crossbow/string.hpp>
+
+#include <boost/preprocessor/seq/for_each.hpp>
+#include <boost/preprocessor/stringize.hpp>
+#include <boost/preprocessor/variadic/to_seq.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace tell {
+namespace db {
+
+/**
+ * @brief Compile time mapping of the struct S to the fields of a table
+ *
+ * Specializations are generated with TELLDB_TUPLE_MAPPING. They provide a static function visit(visitor) calling
+ * visitor(name, &S::member) for every mapped member.
+ */
+template<class S>
+struct TupleMapping;
+
+/**
+ * @brief Maps the given members of a struct to the fields of the same name
+ *
+ * Has to be used in the global namespace, the struct name has to be fully qualified:
+ *
+ * @code
+ * struct District {
+ *     int16_t d_id;
+ *     crossbow::string d_name;
+ *     double d_ytd;
+ * };
+ * TELLDB_TUPLE_MAPPING(District, d_id, d_name, d_ytd)
+ * @endcode
+ *
+ * The members must have one of the types of FieldTypeOf.
+ */
+#define TELLDB_TUPLE_MAPPING(Struct, ...)                                                                               \
+    namespace tell {                                                                                                    \
+    namespace db {                                                                                                      \
+    template<>                                                                                                          \
+    struct TupleMapping<Struct> {                                                                                       \
+        template<class Visitor>                                                                                         \
+        static void visit(Visitor& visitor) {                                                                           \
+            BOOST_PP_SEQ_FOR_EACH(TELLDB_TUPLE_MAPPING_MEMBER, Struct, BOOST_PP_VARIADIC_TO_SEQ(__VA_ARGS__))           \
+        }                                                                                                               \
+    };                                                                                                                  \
+    }                                                                                                                   \
+    }
+
+#define TELLDB_TUPLE_MAPPING_MEMBER(r, Struct, member) visitor(BOOST_PP_STRINGIZE(member), &Struct::member);
+
+template<class S>
+class MappedTuple;
+
+/**
+ * @brief Converts between a mapped struct and the records of a table
+ *
+ * The fields are resolved once when the mapper is created, the mapper can be kept for the lifetime of the process.
+ * Values are read from and written to the records directly, without building a Field per value.
+ *
+ * @code
+ * static TupleMapper<District> districts(transaction.getSchema(districtTable));
+ * auto district = districts.read(transaction.get(districtTable, key).get());
+ * district.d_ytd += amount;
+ * transaction.update(districtTable, key, old, districts, district);
+ * @endcode
+ */
+template<class S>
+class TupleMapper {
+    friend class MappedTuple<S>;
+public: // types
+    using id_t = store::Schema::id_t;
+private: // members
+    /// Field id of every mapped member
+    std::vector<id_t> mIds;
+    /// Position of every variable sized member in the heap of the record (ordered by field id), 0 for the others
+    std::vector<size_t> mHeapRanks;
+    size_t mNumVarSize = 0;
+public:
+    /**
+     * @brief Creates a schema with a not null field for every mapped member
+     */
+    static store::Schema schema(store::TableType type) {
+        store::Schema result(type);
+        SchemaBuilder builder{result};
+        TupleMapping<S>::visit(builder);
+        return result;
+    }
+
+    /**
+     * @brief Resolves the mapped members against the schema
+     *
+     * @throws FieldDoesNotExist If a member has no field
+     * @throws WrongFieldType If the type of a member does not match the one of its field
+     * @throws FieldNotSet If a field of the schema is not mapped
+     * @throws std::invalid_argument If two members map to the same field
+     */
+    explicit TupleMapper(const store::Schema& schema) {
+        Resolver resolver{schema, mIds};
+        TupleMapping<S>::visit(resolver);
+        for (size_t i = 1; i < mIds.size(); ++i) {
+            for (size_t j = 0; j < i; ++j) {
+                if (mIds[i] == mIds[j]) {
+                    throw std::invalid_argument(("Field " + impl::fieldOf(schema, mIds[i])->name()
+                            + " is mapped by more than one member").c_str());
+                }
+            }
+        }
+        auto numFixedSize = schema.fixedSizeFields().size();
+        if (mIds.size() != numFixedSize + schema.varSizeFields().size()) {
+            for (const auto* fields : {&schema.fixedSizeFields(), &schema.varSizeFields()}) {
+                for (const auto& field : *fields) {
+                    if (!isMapped(impl::resolveField(schema, field.name(), field.type()))) {
+                        throw FieldNotSet(field.name());
+                    }
+                }
+            }
+        }
+        mHeapRanks.resize(mIds.size(), 0);
+        for (size_t i = 0; i < mIds.size(); ++i) {
+            if (mIds[i] >= numFixedSize) {
+                mHeapRanks[i] = mIds[i] - numFixedSize;
+                ++mNumVarSize;
+            }
+        }
+    }
+
+    /**
+     * @brief Reads all mapped members from the tuple
+     */
+    S read(const Tuple& tuple) const {
+        S result;
+        read(tuple, result);
+        return result;
+    }
+
+    void read(const Tuple& tuple, S& value) const {
+        Reader reader{tuple, mIds, value, 0};
+        TupleMapping<S>::visit(reader);
+    }
+
+    /**
+     * @brief Serializes the value into a record allocated from the pool and wraps it into a tuple
+     *
+     * The fields of the tuple are only decoded if they are accessed.
+     */
+    Tuple write(const store::Record& record, const S& value, crossbow::ChunkMemoryPool& pool) const;
+
+private:
+    bool isMapped(id_t id) const {
+        for (auto i : mIds) {
+            if (i == id) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    struct SchemaBuilder {
+        store::Schema& schema;
+
+        template<class T>
+        void operator() (const char* name, T S::*) {
+            schema.addField(FieldTypeOf<T>::value, name, true);
+        }
+    };
+
+    struct Resolver {
+        const store::Schema& schema;
+        std::vector<id_t>& ids;
+
+        template<class T>
+        void operator() (const char* name, T S::*) {
+            ids.push_back(impl::resolveField(schema, name,
+                    FieldTypeOf<T>::value,
+                    impl::AlternativeFieldType<T>::value));
+        }
+    };
+
+    struct Reader {
+        const Tuple& tuple;
+        const std::vector<id_t>& ids;
+        S& value;
+        size_t index;
+
+        template<class T>
+        void operator() (const char*, T S::* member) {
+            value.*member = tuple.get<T>(ids[index++]);
+        }
+    };
+};
+
+/**
+ * @brief Serializer of a mapped struct
+ *
+ * Writes the members straight into the record layout of the table.
+ */
+template<class S>
+class MappedTuple : public store::AbstractTuple {
+    using id_t = store::Schema::id_t;
+    const TupleMapper<S>& mMapper;
+    const store::Record& mRecord;
+    const S& mValue;
+public:
+    MappedTuple(const TupleMapper<S>& mapper, const store::Record& record, const S& value)
+        : mMapper(mapper)
+        , mRecord(record)
+        , mValue(value)
+    {}
+
+    size_t size() const override {
+        SizeVisitor visitor{mValue, mRecord.staticSize()};
+        TupleMapping<S>::visit(visitor);
+        return crossbow::align(visitor.size, 8u);
+    }
+
+    void serialize(char* dest) const override {
+        if (!mRecord.schema().allNotNull()) {
+            // All mapped fields are set
+            memset(dest, 0, mRecord.headerSize());
+        }
+        FixedSizeWriter fixedSize{mMapper, mRecord, mValue, dest, 0};
+        TupleMapping<S>::visit(fixedSize);
+        // The heap of a record holds the variable sized fields ordered by field id
+        uint32_t heapOffset = mRecord.staticSize();
+        for (size_t rank = 0; rank < mMapper.mNumVarSize; ++rank) {
+            HeapWriter heap{mMapper, mRecord, mValue, dest, rank, heapOffset, 0};
+            TupleMapping<S>::visit(heap);
+            heapOffset = heap.offset;
+        }
+        if (mMapper.mNumVarSize != 0) {
+            *reinterpret_cast<uint32_t*>(dest + mRecord.staticSize() - sizeof(uint32_t)) = heapOffset;
+        }
+    }
+
+private:
+    struct SizeVisitor {
+        const S& value;
+        size_t size;
+
+        template<class T>
+        void operator() (const char*, T S::*) {
+        }
+
+        void operator() (const char*, crossbow::string S::* member) {
+            size += (value.*member).size();
+        }
+    };
+
+    struct FixedSizeWriter {
+        const TupleMapper<S>& mapper;
+        const store::Record& record;
+        const S& value;
+        char* dest;
+        size_t index;
+
+        template<class T>
+        void operator() (const char*, T S::* member) {
+            auto offset = record.getFieldMeta(mapper.mIds[index++]).offset;
+            *reinterpret_cast<T*>(dest + offset) = value.*member;
+        }
+
+        void operator() (const char*, crossbow::string S::*) {
+            ++index;
+        }
+    };
+
+    struct HeapWriter {
+        const TupleMapper<S>& mapper;
+        const store::Record& record;
+        const S& value;
+        char* dest;
+        size_t rank;
+        uint32_t offset;
+        size_t index;
+
+        template<class T>
+        void operator() (const char*, T S::*) {
+            ++index;
+        }
+
+        void operator() (const char*, crossbow::string S::* member) {
+            auto i = index++;
+            if (mapper.mHeapRanks[i] != rank) {
+                return;
+            }
+            const auto& str = value.*member;
+            *reinterpret_cast<uint32_t*>(dest + record.getFieldMeta(mapper.mIds[i]).offset) = offset;
+            memcpy(dest + offset, str.data(), str.size());
+            offset += str.size();
+        }
+    };
+};
+
+template<class S>
+Tuple TupleMapper<S>::write(const store::Record& record, const S& value, crossbow::ChunkMemoryPool& pool) const {
+    MappedTuple<S> mapped(*this, record, value);
+    auto size = mapped.size();
+    auto data = reinterpret_cast<char*>(pool.allocate(size));
+    mapped.serialize(data);
+    return Tuple(record, data, static_cast<uint32_t>(size), pool);
+}
+
+} // namespace db
+} // namespace tell
@@ -0,0 +1,176 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+
+#undef NDEBUG
+
+#include "FlatMap.hpp"
+
+#include <crossbow/ChunkAllocator.hpp>
+
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace tell::db;
+
+namespace {
+
+using Map = FlatMap<tell::db::key_t, uint64_t>;
+
+tell::db::key_t key(uint64_t value) {
+    return tell::db::key_t{value};
+}
+
+/**
+ * Checks that iterating visits every entry exactly once
+ */
+void checkIteration(const Map& map) {
+    size_t count = 0;
+    for (const auto& entry : map) {
+        assert(map.find(entry.first) != map.end());
+        ++count;
+    }
+    assert(count == map.size());
+}
+
+/**
+ * Erased entries leave tombstones behind that must not hide entries further along the probe sequence
+ */
+void testTombstones() {
+    crossbow::ChunkMemoryPool pool;
+    Map map(&pool);
+    for (uint64_t i = 0; i < 10; ++i) {
+        assert(map.emplace(key(i), i).second);
+    }
+    for (uint64_t i = 0; i < 10; i += 2) {
+        assert(map.erase(key(i)) == 1);
+    }
+    assert(map.erase(key(0)) == 0);
+    assert(map.size() == 5);
+    for (uint64_t i = 0; i < 10; ++i) {
+        assert(map.count(key(i)) == i % 2);
+    }
+    checkIteration(map);
+
+    // Reinserting reuses the tombstones and must not duplicate the entries still in the map
+    for (uint64_t i = 0; i < 10; ++i) {
+        auto res = map.emplace(key(i), i + 100);
+        assert(res.second == (i % 2 == 0));
+        assert(res.first->second == (i % 2 == 0 ? i + 100 : i));
+    }
+    assert(map.size() == 10);
+    checkIteration(map);
+}
+
+/**
+ * Inserting and erasing with a constant number of entries fills the table with tombstones, the map has to rehash
+ * without growing
+ */
+void testRehashSameCapacity() {
+    crossbow::ChunkMemoryPool pool;
+    FlatMap<tell::db::key_t, std::string> map(&pool);
+    map.emplace(key(0), "live");
+    for (uint64_t i = 1; i < 1000; ++i) {
+        map.emplace(key(i), std::to_string(i));
+        assert(map.at(key(i)) == std::to_string(i));
+        assert(map.erase(key(i)) == 1);
+        assert(map.size() == 1);
+        assert(map.at(key(0)) == "live");
+    }
+    for (uint64_t i = 1; i < 1000; ++i) {
+        assert(map.count(key(i)) == 0);
+    }
+    size_t count = 0;
+    for (auto& entry : map) {
+        assert(entry.first == key(0));
+        ++count;
+    }
+    assert(count == 1);
+}
+
+/**
+ * Emplacing a key already in the map must not rehash, even when the map is about to grow
+ */
+void testEmplaceExistingKeepsReferences() {
+    crossbow::ChunkMemoryPool pool;
+    Map map(&pool, 8);
+    uint64_t i = 0;
+    auto first = map.emplace(key(i), i).first;
+    auto& value = first->second;
+    for (++i; i < 8; ++i) {
+        map.emplace(key(i), i);
+    }
+    for (i = 0; i < 8; ++i) {
+        auto res = map.emplace(key(0), 42);
+        assert(!res.second);
+        assert(&res.first->second == &value);
+        assert(res.first == first);
+    }
+    assert(value == 0);
+    assert(map.size() == 8);
+}
+
+/**
+ * Erasing through an iterator returns the iterator to the next entry and never moves other entries
+ */
+void testEraseDuringIteration() {
+    crossbow::ChunkMemoryPool pool;
+    Map map(&pool);
+    for (uint64_t i = 0; i < 100; ++i) {
+        map.emplace(key(i), i);
+    }
+
+    std::vector<bool> visited(100, false);
+    for (auto iter = map.begin(); iter != map.end();) {
+        assert(!visited[iter->second]);
+        visited[iter->second] = true;
+        if (iter->second % 2 == 1) {
+            iter = map.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+    for (uint64_t i = 0; i < 100; ++i) {
+        assert(visited[i]);
+        assert(map.count(key(i)) == (i % 2 == 0 ? 1u : 0u));
+    }
+    assert(map.size() == 50);
+    checkIteration(map);
+
+    for (auto iter = map.begin(); iter != map.end();) {
+        iter = map.erase(iter);
+    }
+    assert(map.empty());
+    assert(map.begin() == map.end());
+}
+
+} // anonymous namespace
+
+int main() {
+    testTombstones();
+    testRehashSameCapacity();
+    testEmplaceExistingKeepsReferences();
+    testEraseDuringIteration();
+    return 0;
+}
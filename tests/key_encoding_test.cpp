@@ -0,0 +1,146 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+
+#undef NDEBUG
+
+#include "KeyEncoding.hpp"
+
+#include <telldb/IndexKey.hpp>
+
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+using namespace tell::db;
+using namespace tell::db::impl;
+
+namespace {
+
+/**
+ * Bytewise comparison as done by the index
+ */
+int compare(const EncodedKey& lhs, const EncodedKey& rhs) {
+    auto res = std::memcmp(lhs.data(), rhs.data(), std::min(lhs.size(), rhs.size()));
+    if (res != 0) {
+        return res;
+    }
+    return lhs.size() < rhs.size() ? -1 : (lhs.size() > rhs.size() ? 1 : 0);
+}
+
+/**
+ * Checks that the keys round trip and that their encodings are in strictly ascending order
+ */
+void checkAscending(const std::vector<KeyType>& keys) {
+    std::vector<EncodedKey> encoded;
+    for (const auto& key : keys) {
+        encoded.push_back(encodeKey(key));
+        auto decoded = decodeKey(encoded.back());
+        assert(encodeKey(decoded) == encoded.back());
+    }
+    for (size_t i = 1; i < encoded.size(); ++i) {
+        assert(compare(encoded[i - 1], encoded[i]) < 0);
+    }
+}
+
+template<class T>
+void checkIntegers() {
+    std::vector<KeyType> keys;
+    for (auto value : {std::numeric_limits<T>::min(), T(std::numeric_limits<T>::min() + 1), T(-256), T(-255), T(-1),
+            T(0), T(1), T(255), T(256), T(std::numeric_limits<T>::max() - 1), std::numeric_limits<T>::max()}) {
+        keys.push_back({Field(value)});
+        assert(decodeKey(encodeKey(keys.back()))[0].template value<T>() == value);
+    }
+    checkAscending(keys);
+}
+
+template<class T>
+void checkFloats() {
+    auto inf = std::numeric_limits<T>::infinity();
+    auto nan = std::numeric_limits<T>::quiet_NaN();
+    std::vector<KeyType> keys;
+    for (auto value : {-nan, -inf, std::numeric_limits<T>::lowest(), T(-1.5), T(-1), -std::numeric_limits<T>::min(),
+            -std::numeric_limits<T>::denorm_min(), T(0), std::numeric_limits<T>::denorm_min(),
+            std::numeric_limits<T>::min(), T(1), T(1.5), std::numeric_limits<T>::max(), inf, nan}) {
+        keys.push_back({Field(value)});
+        auto decoded = decodeKey(encodeKey(keys.back()))[0].template value<T>();
+        if (std::isnan(value)) {
+            assert(std::isnan(decoded) && std::signbit(decoded) == std::signbit(value));
+        } else {
+            assert(decoded == value);
+        }
+    }
+    checkAscending(keys);
+
+    // -0.0 and +0.0 compare equal and get the same key
+    auto negativeZero = encodeKey({Field(-T(0))});
+    assert(negativeZero == encodeKey({Field(T(0))}));
+    assert(!std::signbit(decodeKey(negativeZero)[0].template value<T>()));
+    IndexKey indexKey;
+    indexKey.append(-T(0));
+    assert(indexKey.data() == negativeZero);
+}
+
+void checkStrings() {
+    std::vector<KeyType> keys;
+    for (auto value : {crossbow::string(""), crossbow::string("\0", 1), crossbow::string("\0\0", 2),
+            crossbow::string("\0\x01", 2), crossbow::string("\x01", 1), crossbow::string("a"),
+            crossbow::string("a\0", 2), crossbow::string("a\0b", 3), crossbow::string("a\x01", 2),
+            crossbow::string("ab"), crossbow::string("b"), crossbow::string("\xFF", 1)}) {
+        keys.push_back({Field(value)});
+        assert(decodeKey(encodeKey(keys.back()))[0].value<crossbow::string>() == value);
+    }
+    checkAscending(keys);
+}
+
+void checkMultiColumn() {
+    // A shorter key is a prefix of the longer ones and sorts first, every column decides before the next one
+    checkAscending({
+        {Field(int32_t(-1))},
+        {Field(int32_t(-1)), Field(nullptr)},
+        {Field(int32_t(-1)), Field(crossbow::string(""))},
+        {Field(int32_t(-1)), Field(crossbow::string("a")), Field(-1.0)},
+        {Field(int32_t(-1)), Field(crossbow::string("a")), Field(1.0)},
+        {Field(int32_t(-1)), Field(crossbow::string("a\0", 2))},
+        {Field(int32_t(0))},
+        {Field(int32_t(0)), Field(int64_t(-5))},
+    });
+
+    auto key = IndexKey::of(int32_t(-5), int64_t(7), crossbow::string("x\0y", 3));
+    assert(key.data() == encodeKey({Field(int32_t(-5)), Field(int64_t(7)), Field(crossbow::string("x\0y", 3))}));
+}
+
+} // anonymous namespace
+
+int main() {
+    checkIntegers<int16_t>();
+    checkIntegers<int32_t>();
+    checkIntegers<int64_t>();
+    checkFloats<float>();
+    checkFloats<double>();
+    checkStrings();
+    checkMultiColumn();
+    return 0;
+}
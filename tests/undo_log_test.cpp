@@ -0,0 +1,168 @@
+/*
+ * (C) Copyright 2015 ETH Zurich Systems Group (http://www.systems.ethz.ch/) and others.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * Contributors:
+ *     Markus Pilman <mpilman@inf.ethz.ch>
+ *     Simon Loesing <sloesing@inf.ethz.ch>
+ *     Thomas Etter <etterth@gmail.com>
+ *     Kevin Bocksrocker <kevin.bocksrocker@gmail.com>
+ *     Lucas Braun <braunl@inf.ethz.ch>
+ */
+
+#undef NDEBUG
+
+#include "UndoLog.hpp"
+
+#include <crossbow/ChunkAllocator.hpp>
+
+#include <cassert>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+using namespace tell::db::impl;
+
+namespace {
+
+std::string concat(const UndoLogWriter& log) {
+    std::string res;
+    for (size_t i = 0; i < log.numSegments(); ++i) {
+        res.append(log.segment(i), log.segmentSize(i));
+    }
+    return res;
+}
+
+/**
+ * Writes a log of table 7 with the given keys and an index referencing the first and the last change and a foreign
+ * tuple
+ */
+void writeLog(UndoLogWriter& log, uint64_t firstKey) {
+    uint64_t keys[] = {firstKey, firstKey + 1, firstKey + 1000001};
+    log.writeNumTables(1);
+    log.writeTable(7, keys, 3, 1);
+    log.writeIndex(crossbow::string("idx"), 3);
+    crossbow::string k1("ab\0c", 4);
+    crossbow::string k2("ab\0d", 4);
+    crossbow::string k3("b");
+    log.writeIndexEntry(nullptr, k1, 1, firstKey, keys, 3);
+    log.writeIndexEntry(&k1, k2, 0, uint64_t(1) << 63, keys, 3);
+    log.writeIndexEntry(&k2, k3, 1, firstKey + 1000001, keys, 3);
+}
+
+void checkLog(const UndoLog& log, uint64_t firstKey) {
+    assert(log.tables.size() == 1);
+    const auto& table = log.tables[0];
+    assert(table.tableId == 7);
+    assert(table.keys.size() == 3);
+    assert(table.keys[0] == firstKey);
+    assert(table.keys[1] == firstKey + 1);
+    assert(table.keys[2] == firstKey + 1000001);
+    assert(table.indexes.size() == 1);
+    const auto& index = table.indexes[0];
+    assert(index.name == "idx");
+    assert(index.entries.size() == 3);
+    assert(index.entries[0].key == crossbow::string("ab\0c", 4));
+    assert(index.entries[0].operation == 1);
+    assert(index.entries[0].tupleKey == firstKey);
+    assert(index.entries[1].key == crossbow::string("ab\0d", 4));
+    assert(index.entries[1].operation == 0);
+    assert(index.entries[1].tupleKey == uint64_t(1) << 63);
+    assert(index.entries[2].key == "b");
+    assert(index.entries[2].operation == 1);
+    assert(index.entries[2].tupleKey == firstKey + 1000001);
+}
+
+template<class Fun>
+bool throwsRuntimeError(Fun fun) {
+    try {
+        fun();
+    } catch (std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+} // anonymous namespace
+
+int main() {
+    crossbow::ChunkMemoryPool pool;
+
+    // Round trip of a log split over many small segments
+    {
+        UndoLogWriter log(pool, 5);
+        writeLog(log, 42);
+        assert(log.numSegments() > 1);
+        auto data = concat(log);
+        assert(data.size() == log.size());
+        assert(static_cast<uint8_t>(data[0]) == UndoLogWriter::FORMAT_VERSION);
+        UndoLogReader reader(data.data(), data.size());
+        checkLog(reader.decode(), 42);
+        assert(reader.done());
+    }
+
+    // Logs of several flushes are decoded one after the other
+    {
+        UndoLogWriter first(pool, 16);
+        writeLog(first, 1);
+        UndoLogWriter second(pool, 16);
+        writeLog(second, 0xFFFFFFFFFFull);
+        auto data = concat(first) + concat(second);
+        UndoLogReader reader(data.data(), data.size());
+        checkLog(reader.decode(), 1);
+        assert(!reader.done());
+        checkLog(reader.decode(), 0xFFFFFFFFFFull);
+        assert(reader.done());
+    }
+
+    // Index entries of changed tuples store the position of the key in the changes of the table
+    {
+        UndoLogWriter log(pool, 16);
+        uint64_t keys[] = {5, 1000};
+        crossbow::string key("k");
+        log.writeIndexEntry(nullptr, key, 1, 1000, keys, 2);
+        log.writeIndexEntry(&key, key, 0, 6, keys, 2);
+        std::string expected("\x01" "\x00\x01k\x81\x01" "\x01\x00\x00\x06", 10);
+        expected[0] = static_cast<char>(UndoLogWriter::FORMAT_VERSION);
+        assert(concat(log) == expected);
+    }
+
+    // An empty log only holds the version and the number of tables
+    {
+        UndoLogWriter log(pool, 16);
+        log.writeNumTables(0);
+        auto data = concat(log);
+        UndoLogReader reader(data.data(), data.size());
+        assert(reader.decode().tables.empty());
+        assert(reader.done());
+    }
+
+    // Unknown versions and truncated logs are rejected
+    {
+        UndoLogWriter log(pool, 16);
+        writeLog(log, 42);
+        auto data = concat(log);
+        auto wrongVersion = data;
+        wrongVersion[0] = static_cast<char>(UndoLogWriter::FORMAT_VERSION + 1);
+        assert(throwsRuntimeError([&wrongVersion] () {
+            UndoLogReader(wrongVersion.data(), wrongVersion.size()).decode();
+        }));
+        for (size_t length = 0; length < data.size(); ++length) {
+            assert(throwsRuntimeError([&data, length] () {
+                UndoLogReader(data.data(), length).decode();
+            }));
+        }
+    }
+    return 0;
+}